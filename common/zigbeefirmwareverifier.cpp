@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareverifier.h"
+
+#include <QFile>
+#include <QCryptographicHash>
+
+#include <sys/stat.h>
+
+QByteArray ZigbeeFirmwareVerifier::cachedSha512(const QString &fileName) const
+{
+    FileStamp stamp;
+    if (!readStamp(fileName, &stamp)) {
+        return QByteArray();
+    }
+
+    QHash<QString, CacheEntry>::const_iterator it = m_cache.constFind(fileName);
+    if (it != m_cache.constEnd() && it->stamp == stamp) {
+        return it->sha512;
+    }
+    return QByteArray();
+}
+
+void ZigbeeFirmwareVerifier::store(const QString &fileName, const QByteArray &sha512)
+{
+    CacheEntry entry;
+    if (sha512.isEmpty() || !readStamp(fileName, &entry.stamp)) {
+        m_cache.remove(fileName);
+        return;
+    }
+    entry.sha512 = sha512;
+    m_cache.insert(fileName, entry);
+}
+
+void ZigbeeFirmwareVerifier::store(const QString &fileName, const Checksum &checksum)
+{
+    // The file may have been replaced while it was hashed, the checksum would belong to the old content then
+    FileStamp stamp;
+    if (checksum.sha512.isEmpty() || !readStamp(fileName, &stamp) || !(stamp == checksum.stamp)) {
+        m_cache.remove(fileName);
+        return;
+    }
+    CacheEntry entry;
+    entry.stamp = stamp;
+    entry.sha512 = checksum.sha512;
+    m_cache.insert(fileName, entry);
+}
+
+void ZigbeeFirmwareVerifier::invalidate(const QString &fileName)
+{
+    m_cache.remove(fileName);
+}
+
+ZigbeeFirmwareVerifier::Checksum ZigbeeFirmwareVerifier::calculateChecksum(const QString &fileName)
+{
+    Checksum checksum;
+    if (readStamp(fileName, &checksum.stamp)) {
+        checksum.sha512 = calculateSha512(fileName);
+    }
+    return checksum;
+}
+
+QByteArray ZigbeeFirmwareVerifier::calculateSha512(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha512);
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+    while (!file.atEnd()) {
+        qint64 length = file.read(buffer.data(), buffer.size());
+        if (length < 0) {
+            return QByteArray();
+        }
+        hash.addData(buffer.constData(), static_cast<int>(length));
+    }
+    return hash.result().toHex();
+}
+
+bool ZigbeeFirmwareVerifier::readStamp(const QString &fileName, FileStamp *stamp)
+{
+    struct stat fileStat;
+    if (::stat(QFile::encodeName(fileName).constData(), &fileStat) != 0) {
+        return false;
+    }
+    stamp->size = fileStat.st_size;
+    stamp->modificationTime = static_cast<qint64>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+    stamp->inode = fileStat.st_ino;
+    stamp->device = fileStat.st_dev;
+    return true;
+}
+
+bool ZigbeeFirmwareVerifier::FileStamp::operator==(const FileStamp &other) const
+{
+    return size == other.size
+            && modificationTime == other.modificationTime
+            && inode == other.inode
+            && device == other.device;
+}
@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWAREVERIFIER_H
+#define ZIGBEEFIRMWAREVERIFIER_H
+
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+// Calculates SHA-512 checksums of cached firmware files. Stored results are remembered per file and
+// only valid as long as the file hasn't been modified (size, modification time or inode unchanged).
+class ZigbeeFirmwareVerifier
+{
+public:
+    static const int chunkSize = 64 * 1024;
+
+    struct FileStamp {
+        qint64 size = -1;
+        qint64 modificationTime = 0;
+        quint64 inode = 0;
+        quint64 device = 0;
+
+        bool operator==(const FileStamp &other) const;
+    };
+
+    // A checksum along with the state of the file before it has been calculated
+    struct Checksum {
+        FileStamp stamp;
+        QByteArray sha512;
+    };
+
+    // Returns the checksum only if it is known already for the current state of the file, never calculates it
+    QByteArray cachedSha512(const QString &fileName) const;
+
+    // Remember an already known checksum, e.g. calculated while writing the file
+    void store(const QString &fileName, const QByteArray &sha512);
+    // Remember a calculated checksum, unless the file has been modified since the calculation started
+    void store(const QString &fileName, const Checksum &checksum);
+    void invalidate(const QString &fileName);
+
+    // Safe to be called from a worker thread. The checksum is empty if the file can't be read.
+    static Checksum calculateChecksum(const QString &fileName);
+
+private:
+    struct CacheEntry {
+        FileStamp stamp;
+        QByteArray sha512;
+    };
+
+    static QByteArray calculateSha512(const QString &fileName);
+    static bool readStamp(const QString &fileName, FileStamp *stamp);
+
+    QHash<QString, CacheEntry> m_cache;
+};
+
+#endif // ZIGBEEFIRMWAREVERIFIER_H
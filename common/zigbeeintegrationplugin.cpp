@@ -29,6 +29,8 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "zigbeeintegrationplugin.h"
+#include "zigbeefirmwareindexreader.h"
+#include "zigbeeotaimagewriter.h"
 
 #include <hardware/zigbee/zigbeehardwareresource.h>
 #include <network/networkaccessmanager.h>
@@ -53,57 +55,160 @@
 
 #include <QColor>
 #include <QNetworkRequest>
-#include <QJsonDocument>
 #include <QStandardPaths>
 #include <QFile>
-#include <QDataStream>
+#include <QTimer>
+#include <QSettings>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QtConcurrent/QtConcurrentRun>
 #include <qmath.h>
 
+struct FirmwareImportResult {
+    QString errorString;
+    QByteArray sha512;
+};
+
+// Copies an image from the local firmware repository into the cache. Runs in a worker thread and
+// stops, discarding the partial image, as soon as cancelled is set.
+static FirmwareImportResult importFirmwareFile(const ZigbeeFirmwareIndexEntry &info, const QString &source, const QString &target, QSharedPointer<QAtomicInt> cancelled)
+{
+    FirmwareImportResult result;
+    QFile file(source);
+    if (!file.open(QFile::ReadOnly)) {
+        result.errorString = file.errorString();
+        return result;
+    }
+    ZigbeeOtaImageWriter writer(info, target);
+    if (!writer.open()) {
+        result.errorString = writer.errorString();
+        return result;
+    }
+    bool success = true;
+    while (success && !file.atEnd()) {
+        if (cancelled->loadAcquire()) {
+            result.errorString = "Cancelled";
+            writer.cancel();
+            return result;
+        }
+        success = writer.write(file.read(ZigbeeFirmwareVerifier::chunkSize));
+    }
+    if (!success || !writer.finish()) {
+        result.errorString = writer.errorString();
+        writer.cancel();
+        return result;
+    }
+    result.sha512 = writer.sha512();
+    return result;
+}
+
 ZigbeeIntegrationPlugin::ZigbeeIntegrationPlugin(ZigbeeHardwareResource::HandlerType handlerType, const QLoggingCategory &loggingCategory):
     m_handlerType(handlerType),
     m_dc(loggingCategory.categoryName())
 {
-
+    m_stateBinder = new ZigbeeStateBinder(loggingCategory, this);
 }
 
 ZigbeeIntegrationPlugin::~ZigbeeIntegrationPlugin()
 {
+    qDeleteAll(m_otaSessions);
 
+    if (m_firmwareIndexService) {
+        m_firmwareIndexService->release(this);
+    }
+    if (m_otaScheduler) {
+        m_otaScheduler->release(this);
+    }
+    if (m_firmwareCache) {
+        m_firmwareCache->release(this);
+    }
 }
 
 void ZigbeeIntegrationPlugin::init()
 {
+    m_thingClassIds.build(supportedThings());
+
     hardwareManager()->zigbeeResource()->registerHandler(this, m_handlerType);
 
+    // The index is shared with all other zigbee plugins using the same index url
+    m_firmwareIndexService = ZigbeeFirmwareIndexService::acquire(m_firmwareIndexUrl, this, [this](const QByteArray &data){
+        return firmwareIndexFromJson(data);
+    });
+
     updateFirmwareIndex();
+
+    // The scheduler is shared with all other zigbee plugins
+    m_otaScheduler = ZigbeeOtaScheduler::acquire(this);
+    connect(m_otaScheduler, &ZigbeeOtaScheduler::transferAdmitted, this, &ZigbeeIntegrationPlugin::otaTransferAdmitted);
+    connect(m_otaScheduler, &ZigbeeOtaScheduler::imageNotifyDue, this, &ZigbeeIntegrationPlugin::otaImageNotifyDue);
+    if (m_maximumOtaTransfers > 0) {
+        m_otaScheduler->setMaximumTransfers(m_maximumOtaTransfers);
+    }
+    if (m_imageNotifyWindow >= 0) {
+        m_otaScheduler->setNotifyWindow(m_imageNotifyWindow);
+    }
+
+    m_firmwareCache = ZigbeeFirmwareCacheManager::acquire(this);
+    if (m_firmwareCacheBudget > 0) {
+        m_firmwareCache->setBudget(m_firmwareCacheBudget);
+    }
+
+    // Local images are merged into the shared index, all plugins get the same catalog
+    if (m_localFirmwareRepository.isEmpty()) {
+        m_localFirmwareRepository = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/zigbee-firmwares";
+    }
+    QDir().mkpath(m_localFirmwareRepository);
+    connect(m_firmwareIndexService, &ZigbeeFirmwareIndexService::catalogChanged, this, &ZigbeeIntegrationPlugin::firmwareCatalogChanged);
+    m_firmwareIndexService->setLocalRepository(m_localFirmwareRepository);
+    firmwareCatalogChanged();
 }
 
 void ZigbeeIntegrationPlugin::handleRemoveNode(ZigbeeNode *node, const QUuid &networkUuid)
 {
     Q_UNUSED(networkUuid)
-    foreach (Thing *thing, m_thingNodes.keys(node)) {
+    foreach (Thing *thing, m_thingNodes.things(node)) {
         emit autoThingDisappeared(thing->id());
 
         // Removing it from our map to prevent a loop that would ask the zigbee network to remove this node (see thingRemoved())
-        m_thingNodes.remove(thing);
+        m_thingNodes.take(thing);
     }
 }
 
 void ZigbeeIntegrationPlugin::thingRemoved(Thing *thing)
 {
+    m_stateBinder->unbind(thing);
+    closeOtaSession(thing);
+    removeStoredOtaSession(thing);
+    QFile::remove(otaTelemetryFileName(thing));
+    m_enabledFirmwareUpdates.removeAll(thing);
+    m_otaClusters.remove(thing);
+    m_availableFirmwares.remove(thing);
+    m_firmwareQueries.remove(thing);
+    updatePinnedFirmwares();
+
+    // Cancel downloads nobody else is waiting for
+    foreach (FetchFirmwareReply *reply, m_pendingFirmwareDownloads) {
+        reply->removeWaiter(thing);
+    }
+    m_otaScheduler->finishTransfer(thing);
+
+    // Only remove the node from the network once the last thing representing it is gone
     ZigbeeNode *node = m_thingNodes.take(thing);
-    if (node) {
-        QUuid networkUuid = thing->paramValue(thing->thingClass().paramTypes().findByName("networkUuid").id()).toUuid();
+    if (node && !m_thingNodes.contains(node)) {
+        QUuid networkUuid = thing->paramValue(paramTypeId(thing, ZigbeeThingClassIds::ParamNetworkUuid)).toUuid();
         hardwareManager()->zigbeeResource()->removeNodeFromNetwork(networkUuid, node);
     }
 }
 
 bool ZigbeeIntegrationPlugin::manageNode(Thing *thing)
 {
-    QUuid networkUuid = thing->paramValue(thing->thingClass().paramTypes().findByName("networkUuid").id()).toUuid();
-    ZigbeeAddress zigbeeAddress = ZigbeeAddress(thing->paramValue(thing->thingClass().paramTypes().findByName("ieeeAddress").id()).toString());
+    QUuid networkUuid = thing->paramValue(paramTypeId(thing, ZigbeeThingClassIds::ParamNetworkUuid)).toUuid();
+    ZigbeeAddress zigbeeAddress = ZigbeeAddress(thing->paramValue(paramTypeId(thing, ZigbeeThingClassIds::ParamIeeeAddress)).toString());
 
-    ZigbeeNode *node = m_thingNodes.value(thing);
+    ZigbeeNode *node = m_thingNodes.node(thing);
     if (!node) {
         node = hardwareManager()->zigbeeResource()->claimNode(this, networkUuid, zigbeeAddress);
     }
@@ -112,19 +217,26 @@ bool ZigbeeIntegrationPlugin::manageNode(Thing *thing)
         return false;
     }
 
-    m_thingNodes.insert(thing, node);
+    quint8 endpointId = 0;
+    ParamTypeId endpointIdParamTypeId = paramTypeId(thing, ZigbeeThingClassIds::ParamEndpointId);
+    if (!endpointIdParamTypeId.isNull()) {
+        endpointId = thing->paramValue(endpointIdParamTypeId).toUInt();
+    }
+    m_thingNodes.insert(thing, node, endpointId);
 
     // Update connected state
-    thing->setStateValue("connected", node->reachable());
-    connect(node, &ZigbeeNode::reachableChanged, thing, [thing](bool reachable){
-        thing->setStateValue("connected", reachable);
+    StateTypeId connectedStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateConnected);
+    thing->setStateValue(connectedStateTypeId, node->reachable());
+    connect(node, &ZigbeeNode::reachableChanged, thing, [thing, connectedStateTypeId](bool reachable){
+        thing->setStateValue(connectedStateTypeId, reachable);
     });
 
     // Update signal strength
-    thing->setStateValue("signalStrength", qRound(node->lqi() * 100.0 / 255.0));
-    connect(node, &ZigbeeNode::lqiChanged, thing, [thing](quint8 lqi){
+    StateTypeId signalStrengthStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateSignalStrength);
+    thing->setStateValue(signalStrengthStateTypeId, qRound(node->lqi() * 100.0 / 255.0));
+    connect(node, &ZigbeeNode::lqiChanged, thing, [thing, signalStrengthStateTypeId](quint8 lqi){
         uint signalStrength = qRound(lqi * 100.0 / 255.0);
-        thing->setStateValue("signalStrength", signalStrength);
+        thing->setStateValue(signalStrengthStateTypeId, signalStrength);
     });
 
     connect(node, &ZigbeeNode::lastSeenChanged, this, [=](){
@@ -143,12 +255,37 @@ bool ZigbeeIntegrationPlugin::manageNode(Thing *thing)
 
 Thing *ZigbeeIntegrationPlugin::thingForNode(ZigbeeNode *node)
 {
-    return m_thingNodes.key(node);
+    QList<Thing *> things = m_thingNodes.things(node);
+    return things.isEmpty() ? nullptr : things.first();
+}
+
+ParamTypeId ZigbeeIntegrationPlugin::paramTypeId(Thing *thing, ZigbeeThingClassIds::Param param) const
+{
+    return m_thingClassIds.paramTypeId(thing->thingClassId(), param);
+}
+
+StateTypeId ZigbeeIntegrationPlugin::stateTypeId(Thing *thing, ZigbeeThingClassIds::State state) const
+{
+    return m_thingClassIds.stateTypeId(thing->thingClassId(), state);
+}
+
+ActionTypeId ZigbeeIntegrationPlugin::actionTypeId(Thing *thing, ZigbeeThingClassIds::Action action) const
+{
+    return m_thingClassIds.actionTypeId(thing->thingClassId(), action);
 }
 
 ZigbeeNode *ZigbeeIntegrationPlugin::nodeForThing(Thing *thing)
 {
-    return m_thingNodes.value(thing);
+    return m_thingNodes.node(thing);
+}
+
+ZigbeeNodeEndpoint *ZigbeeIntegrationPlugin::endpointForThing(Thing *thing)
+{
+    ZigbeeNode *node = m_thingNodes.node(thing);
+    if (!node) {
+        return nullptr;
+    }
+    return node->getEndpoint(m_thingNodes.endpointId(thing));
 }
 
 void ZigbeeIntegrationPlugin::createThing(const ThingClassId &thingClassId, ZigbeeNode *node, const ParamList &additionalParams)
@@ -158,9 +295,8 @@ void ZigbeeIntegrationPlugin::createThing(const ThingClassId &thingClassId, Zigb
     descriptor.setTitle(QString("%1 (%2 - %3)").arg(deviceClassName).arg(node->manufacturerName()).arg(node->modelName()));
 
     ParamList params;
-    ThingClass tc = supportedThings().findById(thingClassId);
-    params.append(Param(tc.paramTypes().findByName("networkUuid").id(), node->networkUuid().toString()));
-    params.append(Param(tc.paramTypes().findByName("ieeeAddress").id(), node->extendedAddress().toString()));
+    params.append(Param(m_thingClassIds.paramTypeId(thingClassId, ZigbeeThingClassIds::ParamNetworkUuid), node->networkUuid().toString()));
+    params.append(Param(m_thingClassIds.paramTypeId(thingClassId, ZigbeeThingClassIds::ParamIeeeAddress), node->extendedAddress().toString()));
     params.append(additionalParams);
     descriptor.setParams(params);
     emit autoThingsAppeared({descriptor});
@@ -716,25 +852,28 @@ void ZigbeeIntegrationPlugin::connectToPowerConfigurationInputCluster(Thing *thi
         return;
     }
 
-    if (thing->thingClass().hasStateType("batteryLevel") && powerCluster->hasAttribute(ZigbeeClusterPowerConfiguration::AttributeBatteryPercentageRemaining)) {
-        thing->setStateValue("batteryLevel", powerCluster->batteryPercentage());
+    StateTypeId batteryLevelStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateBatteryLevel);
+    StateTypeId batteryCriticalStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateBatteryCritical);
+
+    if (!batteryLevelStateTypeId.isNull() && powerCluster->hasAttribute(ZigbeeClusterPowerConfiguration::AttributeBatteryPercentageRemaining)) {
+        thing->setStateValue(batteryLevelStateTypeId, powerCluster->batteryPercentage());
     }
     if (powerCluster->hasAttribute(ZigbeeClusterPowerConfiguration::AttributeBatteryAlarmState)) {
-        thing->setStateValue("batteryCritical", powerCluster->batteryAlarmState() > 0);
+        thing->setStateValue(batteryCriticalStateTypeId, powerCluster->batteryAlarmState() > 0);
     } else {
-        thing->setStateValue("batteryCritical", thing->stateValue("batteryLevel").toInt() < 10);
+        thing->setStateValue(batteryCriticalStateTypeId, thing->stateValue(batteryLevelStateTypeId).toInt() < 10);
     }
 
     connect(powerCluster, &ZigbeeClusterPowerConfiguration::batteryPercentageChanged, thing, [=](double percentage){
-        if (thing->thingClass().hasStateType("batteryLevel")) {
-            thing->setStateValue("batteryLevel", percentage);
+        if (!batteryLevelStateTypeId.isNull()) {
+            thing->setStateValue(batteryLevelStateTypeId, percentage);
         }
         if (!powerCluster->hasAttribute(ZigbeeClusterPowerConfiguration::AttributeBatteryAlarmState)) {
-            thing->setStateValue("batteryCritical", (percentage < 10.0));
+            thing->setStateValue(batteryCriticalStateTypeId, (percentage < 10.0));
         }
     });
     connect(powerCluster, &ZigbeeClusterPowerConfiguration::batteryAlarmStateChanged, thing, [=](ZigbeeClusterPowerConfiguration::BatteryAlarmMask alarmState){
-        thing->setStateValue("batteryCritical", alarmState > 0);
+        thing->setStateValue(batteryCriticalStateTypeId, alarmState > 0);
     });
 
     powerCluster->readAttributes({
@@ -758,26 +897,15 @@ void ZigbeeIntegrationPlugin::connectToThermostatCluster(Thing *thing, ZigbeeNod
                                        ZigbeeClusterThermostat::AttributePIHeatingDemand,
                                        ZigbeeClusterThermostat::AttributePICoolingDemand});
 
-    connect(thermostatCluster, &ZigbeeClusterThermostat::attributeChanged, thing, [thing](const ZigbeeClusterAttribute &attribute){
-        if (attribute.id() == ZigbeeClusterThermostat::AttributeOccupiedHeatingSetpoint) {
-            thing->setStateValue("targetTemperature", attribute.dataType().toUInt16() * 0.01);
-        }
-        if (attribute.id() == ZigbeeClusterThermostat::AttributeLocalTemperature) {
-            thing->setStateValue("temperature", attribute.dataType().toUInt16() * 0.01);
-        }
-        if (attribute.id() == ZigbeeClusterThermostat::AttributePIHeatingDemand) {
-            thing->setStateValue("heatingOn", attribute.dataType().toUInt8() > 0);
-        }
-        if (attribute.id() == ZigbeeClusterThermostat::AttributePICoolingDemand) {
-            thing->setStateValue("coolingOn", attribute.dataType().toUInt8() > 0);
-        }
-        if (attribute.id() == ZigbeeClusterThermostat::AttributeMinHeatSetpointLimit) {
-            thing->setStateMinValue("targetTemperature", attribute.dataType().toUInt16() * 0.01);
-        }
-        if (attribute.id() == ZigbeeClusterThermostat::AttributeMaxHeatSetpointLimit) {
-            thing->setStateMaxValue("targetTemperature", attribute.dataType().toUInt16() * 0.01);
-        }
-    });
+    StateTypeId targetTemperatureStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateTargetTemperature);
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributeOccupiedHeatingSetpoint, ZigbeeStateBinder::toInt16, targetTemperatureStateTypeId, 0.01},
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributeLocalTemperature, ZigbeeStateBinder::toInt16, stateTypeId(thing, ZigbeeThingClassIds::StateTemperature), 0.01},
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributePIHeatingDemand, ZigbeeStateBinder::toNonZero, stateTypeId(thing, ZigbeeThingClassIds::StateHeatingOn)},
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributePICoolingDemand, ZigbeeStateBinder::toNonZero, stateTypeId(thing, ZigbeeThingClassIds::StateCoolingOn)},
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributeMinHeatSetpointLimit, ZigbeeStateBinder::toInt16, targetTemperatureStateTypeId, 0.01, 0, ZigbeeStateBinding::TargetMinValue},
+                            {ZigbeeClusterLibrary::ClusterIdThermostat, ZigbeeClusterThermostat::AttributeMaxHeatSetpointLimit, ZigbeeStateBinder::toInt16, targetTemperatureStateTypeId, 0.01, 0, ZigbeeStateBinding::TargetMaxValue}
+                        });
 }
 
 void ZigbeeIntegrationPlugin::connectToOnOffInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint, const QString &stateName)
@@ -788,13 +916,11 @@ void ZigbeeIntegrationPlugin::connectToOnOffInputCluster(Thing *thing, ZigbeeNod
         return;
     }
 
-    if (onOffCluster->hasAttribute(ZigbeeClusterOnOff::AttributeOnOff)) {
-        thing->setStateValue(stateName, onOffCluster->power());
-    }
+    StateTypeId onOffStateTypeId = thing->thingClass().stateTypes().findByName(stateName).id();
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdOnOff, ZigbeeClusterOnOff::AttributeOnOff, ZigbeeStateBinder::toBool, onOffStateTypeId}
+                        });
     onOffCluster->readAttributes({ZigbeeClusterOnOff::AttributeOnOff});
-    connect(onOffCluster, &ZigbeeClusterOnOff::powerChanged, thing, [thing, stateName](bool power){
-        thing->setStateValue(stateName, power);
-    });
 }
 
 void ZigbeeIntegrationPlugin::connectToLevelControlInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint, const QString &stateName)
@@ -805,13 +931,11 @@ void ZigbeeIntegrationPlugin::connectToLevelControlInputCluster(Thing *thing, Zi
         return;
     }
 
-    if (levelControlCluster->hasAttribute(ZigbeeClusterLevelControl::AttributeCurrentLevel)) {
-        thing->setStateValue(stateName, levelControlCluster->currentLevel() * 100 / 255);
-    }
+    StateTypeId levelStateTypeId = thing->thingClass().stateTypes().findByName(stateName).id();
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdLevelControl, ZigbeeClusterLevelControl::AttributeCurrentLevel, ZigbeeStateBinder::toLevelPercentage, levelStateTypeId}
+                        });
     levelControlCluster->readAttributes({ZigbeeClusterLevelControl::AttributeCurrentLevel});
-    connect(levelControlCluster, &ZigbeeClusterLevelControl::currentLevelChanged, thing, [thing, stateName](int currentLevel){
-        thing->setStateValue(stateName, currentLevel * 100 / 255);
-    });
 }
 
 void ZigbeeIntegrationPlugin::connectToColorControlInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint)
@@ -821,33 +945,35 @@ void ZigbeeIntegrationPlugin::connectToColorControlInputCluster(Thing *thing, Zi
         qCWarning(m_dc) << "No color control cluster on" << thing->name() << "and endpoint" << endpoint->endpointId();
         return;
     }
-    if (thing->hasState("color")) {
+    StateTypeId colorStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateColor);
+    StateTypeId colorTemperatureStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateColorTemperature);
+    if (!colorStateTypeId.isNull()) {
         if (colorControlCluster->hasAttribute(ZigbeeClusterColorControl::AttributeCurrentX)
                 && colorControlCluster->hasAttribute(ZigbeeClusterColorControl::AttributeCurrentY)) {
             quint16 colorX = colorControlCluster->attribute(ZigbeeClusterColorControl::AttributeCurrentX).dataType().toUInt16();
             quint16 colorY = colorControlCluster->attribute(ZigbeeClusterColorControl::AttributeCurrentY).dataType().toUInt16();
             QColor color = ZigbeeUtils::convertXYToColor(QPoint(colorX, colorY));
-            thing->setStateValue("color", color);
+            thing->setStateValue(colorStateTypeId, color);
         }
 
         colorControlCluster->readAttributes({ZigbeeClusterColorControl::AttributeCurrentX, ZigbeeClusterColorControl::AttributeCurrentY});
-        connect(colorControlCluster, &ZigbeeClusterColorControl::attributeChanged, thing, [thing, colorControlCluster](const ZigbeeClusterAttribute &attribute){
+        connect(colorControlCluster, &ZigbeeClusterColorControl::attributeChanged, thing, [thing, colorControlCluster, colorStateTypeId](const ZigbeeClusterAttribute &attribute){
             if (attribute.id() == ZigbeeClusterColorControl::AttributeCurrentX || attribute.id() == ZigbeeClusterColorControl::AttributeCurrentY) {
                 quint16 colorX = colorControlCluster->attribute(ZigbeeClusterColorControl::AttributeCurrentX).dataType().toUInt16();
                 quint16 colorY = colorControlCluster->attribute(ZigbeeClusterColorControl::AttributeCurrentY).dataType().toUInt16();
                 QColor color = ZigbeeUtils::convertXYToColor(QPoint(colorX, colorY));
-                thing->setStateValue("color", color);
+                thing->setStateValue(colorStateTypeId, color);
             }
         });
     }
-    if (thing->hasState("colorTemperature")) {
+    if (!colorTemperatureStateTypeId.isNull()) {
         if (colorControlCluster->hasAttribute(ZigbeeClusterColorControl::AttributeColorTemperatureMireds)) {
             int colorTemperature = mapColorTemperatureToScaledValue(thing, colorControlCluster->colorTemperatureMireds());
-            thing->setStateValue("colorTemperature", colorTemperature);
+            thing->setStateValue(colorTemperatureStateTypeId, colorTemperature);
         }
         colorControlCluster->readAttributes({ZigbeeClusterColorControl::AttributeColorTemperatureMireds});
-        connect(colorControlCluster, &ZigbeeClusterColorControl::colorTemperatureMiredsChanged, thing, [this, thing](quint16 colorTemperature) {
-            thing->setStateValue("colorTemperature", mapColorTemperatureToScaledValue(thing, colorTemperature));
+        connect(colorControlCluster, &ZigbeeClusterColorControl::colorTemperatureMiredsChanged, thing, [this, thing, colorTemperatureStateTypeId](quint16 colorTemperature) {
+            thing->setStateValue(colorTemperatureStateTypeId, mapColorTemperatureToScaledValue(thing, colorTemperature));
         });
     }
 }
@@ -860,8 +986,9 @@ void ZigbeeIntegrationPlugin::connectToElectricalMeasurementCluster(Thing *thing
         return;
     }
 
-    connect(electricalMeasurementCluster, &ZigbeeClusterElectricalMeasurement::activePowerPhaseAChanged, thing, [thing](qint16 activePowerPhaseA){
-        thing->setStateValue("currentPower", activePowerPhaseA);
+    StateTypeId currentPowerStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateCurrentPower);
+    connect(electricalMeasurementCluster, &ZigbeeClusterElectricalMeasurement::activePowerPhaseAChanged, thing, [thing, currentPowerStateTypeId](qint16 activePowerPhaseA){
+        thing->setStateValue(currentPowerStateTypeId, activePowerPhaseA);
     });
 }
 
@@ -875,12 +1002,14 @@ void ZigbeeIntegrationPlugin::connectToMeteringCluster(Thing *thing, ZigbeeNodeE
 
     meteringCluster->readFormatting();
 
+    StateTypeId totalEnergyConsumedStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateTotalEnergyConsumed);
+    StateTypeId currentPowerStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateCurrentPower);
     connect(meteringCluster, &ZigbeeClusterMetering::currentSummationDeliveredChanged, thing, [=](quint64 currentSummationDelivered){
-        thing->setStateValue("totalEnergyConsumed", 1.0 * currentSummationDelivered * meteringCluster->multiplier() / meteringCluster->divisor());
+        thing->setStateValue(totalEnergyConsumedStateTypeId, 1.0 * currentSummationDelivered * meteringCluster->multiplier() / meteringCluster->divisor());
     });
 
     connect(meteringCluster, &ZigbeeClusterMetering::instantaneousDemandChanged, thing, [=](qint32 instantaneousDemand){
-        thing->setStateValue("currentPower", instantaneousDemand);
+        thing->setStateValue(currentPowerStateTypeId, instantaneousDemand);
     });
 }
 
@@ -892,14 +1021,10 @@ void ZigbeeIntegrationPlugin::connectToTemperatureMeasurementInputCluster(Thing
         return;
     }
 
-    if (temperatureMeasurementCluster->hasAttribute(ZigbeeClusterTemperatureMeasurement::AttributeMaxMeasuredValue)) {
-        thing->setStateValue("temperature", temperatureMeasurementCluster->temperature());
-    }
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdTemperatureMeasurement, ZigbeeClusterTemperatureMeasurement::AttributeMeasuredValue, ZigbeeStateBinder::toInt16, stateTypeId(thing, ZigbeeThingClassIds::StateTemperature), 0.01}
+                        });
     temperatureMeasurementCluster->readAttributes({ZigbeeClusterTemperatureMeasurement::AttributeMeasuredValue});
-    connect(temperatureMeasurementCluster, &ZigbeeClusterTemperatureMeasurement::temperatureChanged, thing, [=](double temperature) {
-        qCDebug(m_dc) << "Temperature for" << thing->name() << "changed to:" << temperature;
-        thing->setStateValue("temperature", temperature);
-    });
 }
 
 void ZigbeeIntegrationPlugin::connectToRelativeHumidityMeasurementInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint)
@@ -910,14 +1035,10 @@ void ZigbeeIntegrationPlugin::connectToRelativeHumidityMeasurementInputCluster(T
         return;
     }
 
-    if (relativeHumidityMeasurementCluster->hasAttribute(ZigbeeClusterRelativeHumidityMeasurement::AttributeMaxMeasuredValue)) {
-        thing->setStateValue("humidity", relativeHumidityMeasurementCluster->humidity());
-    }
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdRelativeHumidityMeasurement, ZigbeeClusterRelativeHumidityMeasurement::AttributeMeasuredValue, ZigbeeStateBinder::toUInt16, stateTypeId(thing, ZigbeeThingClassIds::StateHumidity), 0.01}
+                        });
     relativeHumidityMeasurementCluster->readAttributes({ZigbeeClusterRelativeHumidityMeasurement::AttributeMeasuredValue});
-    connect(relativeHumidityMeasurementCluster, &ZigbeeClusterRelativeHumidityMeasurement::humidityChanged, thing, [=](double humidity) {
-        qCDebug(m_dc) << "Humidity for" << thing->name() << "changed to:" << humidity;
-        thing->setStateValue("humidity", humidity);
-    });
 }
 
 void ZigbeeIntegrationPlugin::connectToIasZoneInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint, const QString &alarmStateName, bool inverted)
@@ -928,6 +1049,9 @@ void ZigbeeIntegrationPlugin::connectToIasZoneInputCluster(Thing *thing, ZigbeeN
         return;
     }
 
+    StateTypeId alarmStateTypeId = thing->thingClass().stateTypes().findByName(alarmStateName).id();
+    StateTypeId tamperedStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateTampered);
+
     qCDebug(m_dc) << "Cluster attributes:" << iasZoneCluster->attributes();
     qCDebug(m_dc) << "Zone state:" << thing->name() << iasZoneCluster->zoneState();
     qCDebug(m_dc) << "Zone type:" << thing->name() << iasZoneCluster->zoneType();
@@ -935,17 +1059,17 @@ void ZigbeeIntegrationPlugin::connectToIasZoneInputCluster(Thing *thing, ZigbeeN
     if (iasZoneCluster->hasAttribute(ZigbeeClusterIasZone::AttributeZoneStatus)) {
         ZigbeeClusterIasZone::ZoneStatusFlags zoneStatus = iasZoneCluster->zoneStatus();
         bool zoneAlarm = zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusAlarm1) || zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusAlarm2);
-        thing->setStateValue(alarmStateName, inverted ? !zoneAlarm : zoneAlarm);
-        if (thing->thingClass().hasStateType("tampered")) {
-            thing->setStateValue("tampered", zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusTamper));
+        thing->setStateValue(alarmStateTypeId, inverted ? !zoneAlarm : zoneAlarm);
+        if (!tamperedStateTypeId.isNull()) {
+            thing->setStateValue(tamperedStateTypeId, zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusTamper));
         }
     }
     connect(iasZoneCluster, &ZigbeeClusterIasZone::zoneStatusChanged, thing, [=](ZigbeeClusterIasZone::ZoneStatusFlags zoneStatus, quint8 extendedStatus, quint8 zoneId, quint16 delays) {
         qCDebug(m_dc) << "Zone status changed to:" << zoneStatus << extendedStatus << zoneId << delays;
         bool zoneAlarm = zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusAlarm1) || zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusAlarm2);
-        thing->setStateValue(alarmStateName, inverted ? !zoneAlarm : zoneAlarm);
-        if (thing->thingClass().hasStateType("tampered")) {
-            thing->setStateValue("tampered", zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusTamper));
+        thing->setStateValue(alarmStateTypeId, inverted ? !zoneAlarm : zoneAlarm);
+        if (!tamperedStateTypeId.isNull()) {
+            thing->setStateValue(tamperedStateTypeId, zoneStatus.testFlag(ZigbeeClusterIasZone::ZoneStatusTamper));
         }
     });
 }
@@ -958,14 +1082,10 @@ void ZigbeeIntegrationPlugin::connectToIlluminanceMeasurementInputCluster(Thing
         return;
     }
 
-    if (illuminanceMeasurementCluster->hasAttribute(ZigbeeClusterIlluminanceMeasurement::AttributeMaxMeasuredValue)) {
-        thing->setStateValue("lightIntensity", qPow(10, (illuminanceMeasurementCluster->illuminance() - 1) / 10000));
-    }
+    m_stateBinder->bind(thing, endpoint, {
+                            {ZigbeeClusterLibrary::ClusterIdIlluminanceMeasurement, ZigbeeClusterIlluminanceMeasurement::AttributeMeasuredValue, ZigbeeStateBinder::toIlluminance, stateTypeId(thing, ZigbeeThingClassIds::StateLightIntensity)}
+                        });
     illuminanceMeasurementCluster->readAttributes({ZigbeeClusterIlluminanceMeasurement::AttributeMeasuredValue});
-    connect(illuminanceMeasurementCluster, &ZigbeeClusterIlluminanceMeasurement::illuminanceChanged, thing, [=](double illuminance) {
-        qCDebug(m_dc) << "Illuminance for" << thing->name() << "changed to:" << illuminance;
-        thing->setStateValue("lightIntensity", qPow(10, (illuminance - 1) / 10000));
-    });
 }
 
 void ZigbeeIntegrationPlugin::connectToOccupancySensingInputCluster(Thing *thing, ZigbeeNodeEndpoint *endpoint)
@@ -974,11 +1094,13 @@ void ZigbeeIntegrationPlugin::connectToOccupancySensingInputCluster(Thing *thing
     if (!occupancyCluster) {
         qCWarning(m_dc) << "Occupancy cluster not found on" << thing;
     } else {
+        StateTypeId isPresentStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateIsPresent);
+        StateTypeId lastSeenTimeStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateLastSeenTime);
         connect(occupancyCluster, &ZigbeeClusterOccupancySensing::occupancyChanged, thing, [=](bool occupancy){
             qCDebug(m_dc) << thing << "occupancy cluster changed" << occupancy;
-            thing->setStateValue("isPresent", occupancy);
+            thing->setStateValue(isPresentStateTypeId, occupancy);
             if (occupancy) {
-                thing->setStateValue("lastSeenTime", QDateTime::currentMSecsSinceEpoch() / 1000);
+                thing->setStateValue(lastSeenTimeStateTypeId, QDateTime::currentMSecsSinceEpoch() / 1000);
             }
         });
     }
@@ -990,32 +1112,34 @@ void ZigbeeIntegrationPlugin::connectToFanControlInputCluster(Thing *thing, Zigb
     if (!fanControlCluster) {
         qCWarning(m_dc) << "Fan control cluster not found on" << thing;
     } else {
+        StateTypeId powerStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StatePower);
+        StateTypeId flowRateStateTypeId = stateTypeId(thing, ZigbeeThingClassIds::StateFlowRate);
         connect(fanControlCluster, &ZigbeeClusterFanControl::fanModeChanged, thing, [=](ZigbeeClusterFanControl::FanMode fanMode){
             qCDebug(m_dc) << thing << "fan mode changed" << fanMode;
             switch (fanMode) {
             case ZigbeeClusterFanControl::FanModeOff:
-                thing->setStateValue("power", false);
+                thing->setStateValue(powerStateTypeId, false);
                 break;
             case ZigbeeClusterFanControl::FanModeLow:
-                thing->setStateValue("power", true);
-                thing->setStateValue("flowRate", 1);
+                thing->setStateValue(powerStateTypeId, true);
+                thing->setStateValue(flowRateStateTypeId, 1);
                 break;
             case ZigbeeClusterFanControl::FanModeMedium:
-                thing->setStateValue("power", true);
-                thing->setStateValue("flowRate", 2);
+                thing->setStateValue(powerStateTypeId, true);
+                thing->setStateValue(flowRateStateTypeId, 2);
                 break;
             case ZigbeeClusterFanControl::FanModeHigh:
-                thing->setStateValue("power", true);
-                thing->setStateValue("flowRate", 3);
+                thing->setStateValue(powerStateTypeId, true);
+                thing->setStateValue(flowRateStateTypeId, 3);
                 break;
             case ZigbeeClusterFanControl::FanModeOn:
-                thing->setStateValue("power", true);
+                thing->setStateValue(powerStateTypeId, true);
                 break;
             case ZigbeeClusterFanControl::FanModeAuto:
-                thing->setStateValue("power", true);
+                thing->setStateValue(powerStateTypeId, true);
                 break;
             case ZigbeeClusterFanControl::FanModeSmart:
-                thing->setStateValue("power", true);
+                thing->setStateValue(powerStateTypeId, true);
                 break;
             }
         });
@@ -1030,33 +1154,38 @@ void ZigbeeIntegrationPlugin::connectToOtaOutputCluster(Thing *thing, ZigbeeNode
         return;
     }
     qCDebug(m_dc) << "Connecting to OTA cluster for" << thing->name();
-    qCDebug(m_dc) << "Sending image notify to" << thing->name();
+    OtaClusterState state;
+    state.cluster = otaCluster;
+    m_otaClusters.insert(thing, state);
 
-    connect(endpoint->node(), &ZigbeeNode::lastSeenChanged, otaCluster, [otaCluster, thing, this](){
-        if (!otaCluster->property("imageNotifyPending").toBool() && otaCluster->property("lastFirmwareCheck").toDateTime().addSecs(60 * 60 * 24) < QDateTime::currentDateTime()) {
-            qCDebug(m_dc) << "Sending image notify to" << thing->name();
-            ZigbeeClusterReply *reply = otaCluster->sendImageNotify();
-            otaCluster->setProperty("imageNotifyPending", true);
+    // Continue a transfer which was interrupted by a restart instead of aborting it on the next block request
+    restoreOtaSession(thing);
 
-            connect(reply, &ZigbeeClusterReply::finished, thing, [this, reply, otaCluster](){
-                qCDebug(m_dc) << "Image notify command finished" << reply->error();
-                otaCluster->setProperty("imageNotifyPending", false);
-            });
+    // Notify devices once a day when they are seen. The scheduler spreads the notifies of all devices over time.
+    connect(endpoint->node(), &ZigbeeNode::lastSeenChanged, otaCluster, [thing, this](){
+        const OtaClusterState state = m_otaClusters.value(thing);
+        if (!state.imageNotifyPending && state.lastFirmwareCheck.addSecs(60 * 60 * 24) < QDateTime::currentDateTime() && !m_otaScheduler->isImageNotifyScheduled(thing)) {
+            qCDebug(m_dc) << "Scheduling image notify for" << thing->name();
+            m_otaScheduler->scheduleImageNotify(thing);
         }
     });
 
     connect(otaCluster, &ZigbeeClusterOta::queryNextImageRequestReceived, thing, [this, otaCluster, thing](quint8 transactionSequenceNumber, quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, quint16 /*hardwareVersion*/){
-        otaCluster->setProperty("lastFirmwareCheck", QDateTime::currentDateTime());
+        m_otaClusters[thing].lastFirmwareCheck = QDateTime::currentDateTime();
 
         ZigbeeNode *node = nodeForThing(thing);
-        FirmwareIndexEntry newInfo = checkFirmwareAvailability(m_firmwareIndex, manufacturerCode, imageType, currentFileVersion, node->modelName());
+        FirmwareIndexEntry newInfo = checkFirmwareAvailability(*firmwareCatalog(), manufacturerCode, imageType, currentFileVersion, node->modelName());
+        m_firmwareQueries.insert(thing, {manufacturerCode, imageType, currentFileVersion, node->modelName()});
         ZigbeeClusterOta::FileVersion currentParsed = ZigbeeClusterOta::parseFileVersion(currentFileVersion);
-        thing->setStateValue("currentVersion", QString("%0.%1.%2.%3")
+        thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateCurrentVersion), QString("%0.%1.%2.%3")
                              .arg(currentParsed.applicationRelease)
                              .arg(currentParsed.applicationBuild)
                              .arg(currentParsed.stackRelease)
                              .arg(currentParsed.stackBuild));
         if (newInfo.fileVersion > 0) {
+            // Keep the image in the cache as long as the device needs it
+            m_availableFirmwares.insert(thing, newInfo);
+            updatePinnedFirmwares();
             ZigbeeClusterOta::FileVersion newParsed = ZigbeeClusterOta::parseFileVersion(newInfo.fileVersion);
             qCDebug(m_dc) << QString("Device %0 requested firmware. Old version: %1.%2.%3.%4, new version: %5.%6.%7.%8")
                              .arg(thing->name())
@@ -1068,87 +1197,177 @@ void ZigbeeIntegrationPlugin::connectToOtaOutputCluster(Thing *thing, ZigbeeNode
                              .arg(newParsed.applicationBuild)
                              .arg(newParsed.stackRelease)
                              .arg(newParsed.stackBuild);
-            thing->setStateValue("availableVersion", QString("%0.%1.%2.%3")
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateAvailableVersion), QString("%0.%1.%2.%3")
                                  .arg(newParsed.applicationRelease)
                                  .arg(newParsed.applicationBuild)
                                  .arg(newParsed.stackRelease)
                                  .arg(newParsed.stackBuild));
-            thing->setStateValue("updateStatus", "available");
-            thing->setStateValue("updateProgress", 0);
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "available");
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
 
             if (!m_enabledFirmwareUpdates.contains(thing)) {
                 qCDebug(m_dc) << "Update not enabled for thing" << thing->name();
                 otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeNoImageAvailable);
+                prefetchFirmware(thing, newInfo);
                 return;
             }
 
-            thing->setStateValue("updateStatus", "updating");
-            if (firmwareFileExists(newInfo)) {
-                qCDebug(m_dc) << "Firmware file is present. Starting update...";
-                otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeSuccess, manufacturerCode, imageType, newInfo.fileVersion, newInfo.fileSize);
-            } else {
+            // Keep the mesh usable by limiting the number of updates running at the same time. Queued
+            // devices are notified once it's their turn.
+            if (!m_otaScheduler->requestTransfer(node->networkUuid(), thing)) {
+                qCDebug(m_dc) << "Other firmware updates are running in this network. Queueing update for" << thing->name();
+                otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeNoImageAvailable);
+                return;
+            }
+
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "updating");
+            verifyFirmwareFile(newInfo, thing, [=](bool valid){
+                if (valid) {
+                    qCDebug(m_dc) << "Firmware file is present. Starting update...";
+                    otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeSuccess, manufacturerCode, imageType, newInfo.fileVersion, newInfo.fileSize);
+                    return;
+                }
+
                 qCDebug(m_dc) << "Downloading firmware file...";
-                FetchFirmwareReply *reply = fetchFirmware(newInfo);
-                connect(reply, &FetchFirmwareReply::finished, otaCluster, [=](){
-                    if (firmwareFileExists(newInfo)) {
-                        qCDebug(m_dc) << "Firmware file downloaded successfully. Starting update...";
-                        otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeSuccess, manufacturerCode, imageType, newInfo.fileVersion, newInfo.fileSize);
-                    } else {
-                        qCWarning(m_dc) << "Failed to download firmware.";
-                        otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeNoImageAvailable);
-                        thing->setStateValue("availableVersion", "-");
-                        thing->setStateValue("updateStatus", "idle");
-                        thing->setStateValue("updateProgress", 0);
-                    }
+                FetchFirmwareReply *reply = fetchFirmware(newInfo, thing);
+                connect(reply, &FetchFirmwareReply::finished, thing, [=](){
+                    verifyFirmwareFile(newInfo, thing, [=](bool valid){
+                        if (valid) {
+                            qCDebug(m_dc) << "Firmware file downloaded successfully. Starting update...";
+                            otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeSuccess, manufacturerCode, imageType, newInfo.fileVersion, newInfo.fileSize);
+                        } else {
+                            qCWarning(m_dc) << "Failed to download firmware.";
+                            m_otaScheduler->finishTransfer(thing);
+                            otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeNoImageAvailable);
+                            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateAvailableVersion), "-");
+                            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "idle");
+                            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
+                        }
+                    });
                 });
-            }
+            });
         } else {
             qCDebug(m_dc) << QString("Device %0 requested firmware. Old version: %1.%2.%3.%4, no new version available.").arg(thing->name()).arg(currentParsed.applicationRelease).arg(currentParsed.applicationBuild).arg(currentParsed.stackRelease).arg(currentParsed.stackBuild);
+            m_availableFirmwares.remove(thing);
+            updatePinnedFirmwares();
+            m_otaScheduler->finishTransfer(thing);
             otaCluster->sendQueryNextImageResponse(transactionSequenceNumber, ZigbeeClusterOta::StatusCodeNoImageAvailable);
-            thing->setStateValue("availableVersion", "-");
-            thing->setStateValue("updateStatus", "idle");
-            thing->setStateValue("updateProgress", 0);
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateAvailableVersion), "-");
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "idle");
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
         }
     });
 
     connect(otaCluster, &ZigbeeClusterOta::imageBlockRequestReceived, thing, [this, thing, otaCluster](quint8 transactionSequenceNumber, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion, quint32 fileOffset, quint8 maximumDataSize, const ZigbeeAddress &requestNodeAddress, quint16 minimumBlockPeriod){
-        Q_UNUSED(requestNodeAddress)
-        Q_UNUSED(minimumBlockPeriod)
         if (!m_enabledFirmwareUpdates.contains(thing)) {
             // If nymea restarted during the process, or the upgrade process has been cancelled in some other way, let's cancel the OTA.
             qCDebug(m_dc) << "Device requested an image block but update is not enabled for" << thing->name();
             otaCluster->sendAbortImageBlockResponse(transactionSequenceNumber);
+            m_otaScheduler->finishTransfer(thing);
             return;
         }
-        FirmwareIndexEntry info = firmwareInfo(manufacturerCode, imageType, fileVersion);
-        QString fileName = firmwareFileName(info);
-        QFile file(fileName);
-        if (!file.open(QFile::ReadOnly)) {
+        ZigbeeNode *node = nodeForThing(thing);
+        if (!node || !m_otaScheduler->requestTransfer(node->networkUuid(), thing)) {
+            // The device started the transfer on its own while others are running. It will be notified when it's its turn.
+            qCDebug(m_dc) << "Device requested an image block but other firmware updates are running in this network. Queueing update for" << thing->name();
+            otaCluster->sendAbortImageBlockResponse(transactionSequenceNumber);
+            return;
+        }
+        ZigbeeOtaSession *session = otaSession(thing, manufacturerCode, imageType, fileVersion);
+        if (!session) {
             qCWarning(m_dc) << "Unable to open firmware file for reading";
             otaCluster->sendAbortImageBlockResponse(transactionSequenceNumber);
+            removeStoredOtaSession(thing);
             m_enabledFirmwareUpdates.removeAll(thing);
+            m_otaScheduler->finishTransfer(thing);
             return;
         }
-        if (!file.seek(fileOffset)) {
-            qCWarning(m_dc) << "Unable to seek in firmware file";
+        if (fileOffset >= session->size()) {
+            qCWarning(m_dc) << "Requested image block offset" << fileOffset << "is out of range";
             otaCluster->sendAbortImageBlockResponse(transactionSequenceNumber);
+            closeOtaSession(thing);
+            removeStoredOtaSession(thing);
             m_enabledFirmwareUpdates.removeAll(thing);
+            m_otaScheduler->finishTransfer(thing);
+            return;
+        }
+
+        if (session->isResponsePending() && session->pendingOffset() == fileOffset) {
+            // The client retried before the paced response went out. This is no loss, answer it with the pending response only.
+            qCDebug(m_dc) << "Image block at offset" << fileOffset << "is already pending for" << thing->name();
+            session->setPendingResponse(fileOffset, transactionSequenceNumber);
             return;
         }
-        QByteArray data = file.read(maximumDataSize);
-        double progress = 100.0 * (fileOffset + data.size()) / info.fileSize;
-        qCDebug(m_dc).nospace() << "Sending firmware image data block to device (" << progress << "%, offset: " << fileOffset << ", size: " << data.size() << ")";
-        thing->setStateValue("updateProgress", qRound(progress));
-        otaCluster->sendImageBlockResponse(transactionSequenceNumber, manufacturerCode, imageType, fileVersion, fileOffset, data);
+
+        // Requesting an offset acknowledges everything before it. Persist the progress once in a while.
+        session->setOffset(fileOffset);
+        if (fileOffset < session->storedOffset() || fileOffset - session->storedOffset() >= session->size() / 100) {
+            storeOtaSession(thing, session);
+        }
+
+        // The link quality is only known if the device requests the block for itself
+        quint8 lqi = 255;
+        if (requestNodeAddress == ZigbeeAddress() || requestNodeAddress == node->extendedAddress()) {
+            lqi = node->lqi();
+        }
+        session->pacer()->requestReceived(fileOffset, lqi);
+        session->telemetry()->requestReceived(fileOffset);
+        quint8 blockSize = session->pacer()->blockSize(maximumDataSize);
+
+        // The cluster doesn't offer the WAIT_FOR_DATA block response, so blocks are paced by delaying the response instead
+        // A request for another offset replaces the pending response, responses scheduled for it are dropped.
+        session->setPendingResponse(fileOffset, transactionSequenceNumber);
+        auto sendBlock = [this, thing, otaCluster, manufacturerCode, imageType, fileVersion, fileOffset, blockSize](){
+            ZigbeeOtaSession *session = m_otaSessions.value(thing);
+            if (!session || !session->matches(manufacturerCode, imageType, fileVersion)) {
+                // The transfer has been finished or cancelled in the meantime
+                return;
+            }
+            if (!session->isResponsePending() || session->pendingOffset() != fileOffset) {
+                // Replaced by a request for another offset, or already answered
+                return;
+            }
+            quint8 transactionSequenceNumber = session->pendingTransactionSequenceNumber();
+            session->clearPendingResponse();
+            QByteArray data = session->block(fileOffset, blockSize);
+            session->pacer()->blockSent(fileOffset, data.size());
+            session->telemetry()->recordBlock(fileOffset, data.size());
+            double progress = 100.0 * (fileOffset + data.size()) / session->size();
+            if (m_dc.isDebugEnabled()) {
+                qCDebug(m_dc).nospace() << "Sending firmware image data block to device (" << progress << "%, offset: " << fileOffset << ", size: " << data.size() << ")";
+            }
+            // Only publish whole percent changes, at a bounded rate
+            if (session->progressReporter()->update(progress)) {
+                thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), session->progressReporter()->reportedProgress());
+                updateOtaTelemetryStates(thing, session->telemetry());
+            }
+            otaCluster->sendImageBlockResponse(transactionSequenceNumber, manufacturerCode, imageType, fileVersion, fileOffset, data);
+        };
+
+        int delay = m_otaScheduler->scheduleBlock(thing, minimumBlockPeriod) + session->pacer()->delay();
+        if (delay > 0) {
+            QTimer::singleShot(delay, thing, sendBlock);
+        } else {
+            sendBlock();
+        }
     });
 
     connect(otaCluster, &ZigbeeClusterOta::upgradeEndRequestReceived, thing, [this, thing, otaCluster](quint8 transactionSequenceNumber, ZigbeeClusterOta::StatusCode statusCode, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion) {
+        // Resolve the image while the session and the stored transfer are still there
+        FirmwareIndexEntry info = otaImage(thing, manufacturerCode, imageType, fileVersion);
         m_enabledFirmwareUpdates.removeAll(thing);
+        closeOtaSession(thing);
+        removeStoredOtaSession(thing);
+        m_otaScheduler->finishTransfer(thing);
         if (statusCode != ZigbeeClusterOta::StatusCodeSuccess) {
             qCWarning(m_dc) << "Image integrity checks failed on the device. Upgrade aborted. Status code:" << statusCode;
-            QFile::remove(firmwareFileName(firmwareInfo(manufacturerCode, imageType, fileVersion)));
-            thing->setStateValue("updateStatus", "idle");
-            thing->setStateValue("updateProgress", 0);
+            if (info.fileVersion != 0) {
+                QString fileName = firmwareFileName(info);
+                QFile::remove(fileName);
+                m_firmwareVerifier.invalidate(fileName);
+            }
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "idle");
+            thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
             otaCluster->sendImageNotify();
             return;
         }
@@ -1159,32 +1378,37 @@ void ZigbeeIntegrationPlugin::connectToOtaOutputCluster(Thing *thing, ZigbeeNode
 //        return;
 
         //Validating the image checksums once again now to make sure it didn't change during the possibly long lasting data transmission.
-        FirmwareIndexEntry info = firmwareInfo(manufacturerCode, imageType, fileVersion);
-        if (firmwareFileExists(info)) { // this also checks the checksum
+        verifyFirmwareFile(info, thing, [=](bool valid){
+            if (!valid) {
+                qCWarning(m_dc) << "Image verification failed. Aborting update.";
+                otaCluster->sendAbortUpgradeEndResponse(transactionSequenceNumber);
+
+                thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "idle");
+                thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
+
+                // Notifying again to obtain the installed firmware version
+                otaCluster->sendImageNotify();
+                return;
+            }
+
             qCDebug(m_dc) << "Completing update.";
             ZigbeeClusterReply *upgradeEndReply = otaCluster->sendUpgradeEndResponse(transactionSequenceNumber, manufacturerCode, imageType, fileVersion);
-            connect(upgradeEndReply, &ZigbeeClusterReply::finished, thing, [thing, otaCluster, upgradeEndReply, this](){
+            connect(upgradeEndReply, &ZigbeeClusterReply::finished, thing, [thing, upgradeEndReply, this](){
                 if (upgradeEndReply->error() != ZigbeeClusterReply::ErrorNoError) {
                     qCWarning(m_dc) << "Failed to send the upgrade end reply" << upgradeEndReply->error();
                 } else {
                     qCDebug(m_dc) << "Update complete.";
                 }
 
-                otaCluster->setProperty("lastFirmwareCheck", QDateTime());
+                // Check again soon to obtain the installed version
+                if (m_otaClusters.contains(thing)) {
+                    m_otaClusters[thing].lastFirmwareCheck = QDateTime();
+                }
 
-                thing->setStateValue("updateStatus", "idle");
-                thing->setStateValue("updateProgress", 0);
+                thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "idle");
+                thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), 0);
             });
-        } else {
-            qCWarning(m_dc) << "Image verification failed. Aborting update.";
-            otaCluster->sendAbortUpgradeEndResponse(transactionSequenceNumber);
-
-            thing->setStateValue("updateStatus", "idle");
-            thing->setStateValue("updateProgress", 0);
-
-            // Notifying again to obtain the installed firmware version
-            otaCluster->sendImageNotify();
-        }
+        });
     });
 }
 
@@ -1196,11 +1420,12 @@ void ZigbeeIntegrationPlugin::connectToAnalogInputCluster(Thing *thing, ZigbeeNo
         return;
     }
 
-    thing->setStateValue(stateName, analogInputCluster->presentValue());
+    StateTypeId presentValueStateTypeId = thing->thingClass().stateTypes().findByName(stateName).id();
+    thing->setStateValue(presentValueStateTypeId, analogInputCluster->presentValue());
     analogInputCluster->readAttributes({ZigbeeClusterAnalogInput::AttributePresentValue});
 
-    connect(analogInputCluster, &ZigbeeClusterAnalogInput::presentValueChanged, thing, [thing, stateName](float presentValue){
-        thing->setStateValue(stateName, presentValue);
+    connect(analogInputCluster, &ZigbeeClusterAnalogInput::presentValueChanged, thing, [thing, presentValueStateTypeId](float presentValue){
+        thing->setStateValue(presentValueStateTypeId, presentValue);
     });
 }
 
@@ -1213,14 +1438,14 @@ void ZigbeeIntegrationPlugin::executePowerOnOffInputCluster(ThingActionInfo *inf
         return;
     }
 
-    bool power = info->action().paramValue(info->thing()->thingClass().actionTypes().findByName("power").id()).toBool();
+    bool power = info->action().paramValue(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionPower)).toBool();
     ZigbeeClusterReply *reply = (power ? onOffCluster->commandOn() : onOffCluster->commandOff());
     connect(reply, &ZigbeeClusterReply::finished, info, [=](){
         if (reply->error() != ZigbeeClusterReply::ErrorNoError) {
             qCWarning(m_dc) << "Failed to set power on" << info->thing()->name() << reply->error();
             info->finish(Thing::ThingErrorHardwareFailure);
         } else {
-            info->thing()->setStateValue("power", power);
+            info->thing()->setStateValue(stateTypeId(info->thing(), ZigbeeThingClassIds::StatePower), power);
             info->finish(Thing::ThingErrorNoError);
         }
     });
@@ -1235,7 +1460,7 @@ void ZigbeeIntegrationPlugin::executeBrightnessLevelControlInputCluster(ThingAct
         return;
     }
 
-    int brightness = info->action().param(info->thing()->thingClass().actionTypes().findByName("brightness").id()).value().toInt();
+    int brightness = info->action().param(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionBrightness)).value().toInt();
     quint8 level = static_cast<quint8>(qRound(255.0 * brightness / 100.0));
 
     ZigbeeClusterReply *reply = levelCluster->commandMoveToLevel(level, 5);
@@ -1244,7 +1469,7 @@ void ZigbeeIntegrationPlugin::executeBrightnessLevelControlInputCluster(ThingAct
             qCWarning(m_dc) << "Failed to set brightness on" << info->thing()->name() << reply->error();
             info->finish(Thing::ThingErrorHardwareFailure);
         } else {
-            info->thing()->setStateValue("brightness", brightness);
+            info->thing()->setStateValue(stateTypeId(info->thing(), ZigbeeThingClassIds::StateBrightness), brightness);
             info->finish(Thing::ThingErrorNoError);
         }
     });
@@ -1258,7 +1483,7 @@ void ZigbeeIntegrationPlugin::executeColorTemperatureColorControlInputCluster(Th
         info->finish(Thing::ThingErrorHardwareFailure);
         return;
     }
-    int colorTemperatureScaled = info->action().param(info->thing()->thingClass().actionTypes().findByName("colorTemperature").id()).value().toInt();
+    int colorTemperatureScaled = info->action().param(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionColorTemperature)).value().toInt();
 
     quint16 colorTemperature = mapScaledValueToColorTemperature(info->thing(), colorTemperatureScaled);
     ZigbeeClusterReply *reply = colorCluster->commandMoveToColorTemperature(colorTemperature, 5);
@@ -1267,7 +1492,7 @@ void ZigbeeIntegrationPlugin::executeColorTemperatureColorControlInputCluster(Th
             qCWarning(m_dc) << "Failed to set color temperature on" << info->thing()->name() << reply->error();
             info->finish(Thing::ThingErrorHardwareFailure);
         } else {
-            info->thing()->setStateValue("colorTemperature", colorTemperatureScaled);
+            info->thing()->setStateValue(stateTypeId(info->thing(), ZigbeeThingClassIds::StateColorTemperature), colorTemperatureScaled);
             info->finish(Thing::ThingErrorNoError);
         }
     });
@@ -1282,7 +1507,7 @@ void ZigbeeIntegrationPlugin::executeColorColorControlInputCluster(ThingActionIn
         return;
     }
 
-    QColor color = info->action().param(info->thing()->thingClass().actionTypes().findByName("color").id()).value().value<QColor>();
+    QColor color = info->action().param(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionColor)).value().value<QColor>();
     QPoint xyColorInt = ZigbeeUtils::convertColorToXYInt(color);
 
 
@@ -1293,7 +1518,7 @@ void ZigbeeIntegrationPlugin::executeColorColorControlInputCluster(ThingActionIn
             qCWarning(m_dc) << "Failed to set color on" << info->thing()->name() << reply->error();
             info->finish(Thing::ThingErrorHardwareFailure);
         } else {
-            info->thing()->setStateValue("color", color);
+            info->thing()->setStateValue(stateTypeId(info->thing(), ZigbeeThingClassIds::StateColor), color);
             info->finish(Thing::ThingErrorNoError);
         }
     });
@@ -1327,7 +1552,7 @@ void ZigbeeIntegrationPlugin::executePowerFanControlInputCluster(ThingActionInfo
         return;
     }
 
-    ZigbeeClusterReply *reply = fanControlCluster->setFanMode(info->action().paramValue(info->thing()->thingClass().actionTypes().findByName("power").id()).toBool() ? ZigbeeClusterFanControl::FanModeOn : ZigbeeClusterFanControl::FanModeOff);
+    ZigbeeClusterReply *reply = fanControlCluster->setFanMode(info->action().paramValue(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionPower)).toBool() ? ZigbeeClusterFanControl::FanModeOn : ZigbeeClusterFanControl::FanModeOff);
     connect(reply, &ZigbeeClusterReply::finished, this, [reply, info](){
         if (reply->error() != ZigbeeClusterReply::ErrorNoError) {
             info->finish(Thing::ThingErrorHardwareFailure);
@@ -1346,7 +1571,7 @@ void ZigbeeIntegrationPlugin::executeFlowRateFanControlInputCluster(ThingActionI
         return;
     }
 
-    ZigbeeClusterReply *reply = fanControlCluster->setFanMode(static_cast<ZigbeeClusterFanControl::FanMode>(info->action().paramValue(info->thing()->thingClass().actionTypes().findByName("flowRate").id()).toUInt()));
+    ZigbeeClusterReply *reply = fanControlCluster->setFanMode(static_cast<ZigbeeClusterFanControl::FanMode>(info->action().paramValue(actionTypeId(info->thing(), ZigbeeThingClassIds::ActionFlowRate)).toUInt()));
     connect(reply, &ZigbeeClusterReply::finished, this, [reply, info](){
         if (reply->error() != ZigbeeClusterReply::ErrorNoError) {
             info->finish(Thing::ThingErrorHardwareFailure);
@@ -1428,8 +1653,9 @@ quint16 ZigbeeIntegrationPlugin::mapScaledValueToColorTemperature(Thing *thing,
         m_colorTemperatureRanges[thing] = ColorTemperatureRange();
     }
 
-    int minScaleValue = thing->thingClass().stateTypes().findByName("colorTemperature").minValue().toInt();
-    int maxScaleValue = thing->thingClass().stateTypes().findByName("colorTemperature").maxValue().toInt();
+    StateType colorTemperatureStateType = m_thingClassIds.stateType(thing->thingClassId(), ZigbeeThingClassIds::StateColorTemperature);
+    int minScaleValue = colorTemperatureStateType.minValue().toInt();
+    int maxScaleValue = colorTemperatureStateType.maxValue().toInt();
     double percentage = static_cast<double>((scaledColorTemperature - minScaleValue)) / (maxScaleValue - minScaleValue);
     double mappedValue = (m_colorTemperatureRanges[thing].maxValue - m_colorTemperatureRanges[thing].minValue) * percentage + m_colorTemperatureRanges[thing].minValue;
     return static_cast<quint16>(qRound(mappedValue));
@@ -1441,8 +1667,9 @@ int ZigbeeIntegrationPlugin::mapColorTemperatureToScaledValue(Thing *thing, quin
         m_colorTemperatureRanges[thing] = ColorTemperatureRange();
     }
 
-    int minScaleValue = thing->thingClass().stateTypes().findByName("colorTemperature").minValue().toInt();
-    int maxScaleValue = thing->thingClass().stateTypes().findByName("colorTemperature").maxValue().toInt();
+    StateType colorTemperatureStateType = m_thingClassIds.stateType(thing->thingClassId(), ZigbeeThingClassIds::StateColorTemperature);
+    int minScaleValue = colorTemperatureStateType.minValue().toInt();
+    int maxScaleValue = colorTemperatureStateType.maxValue().toInt();
     double percentage = static_cast<double>((colorTemperature - m_colorTemperatureRanges[thing].minValue)) / (m_colorTemperatureRanges[thing].maxValue - m_colorTemperatureRanges[thing].minValue);
     double mappedValue = (maxScaleValue - minScaleValue) * percentage + minScaleValue;
     return static_cast<int>(qRound(mappedValue));
@@ -1465,83 +1692,320 @@ void ZigbeeIntegrationPlugin::setFirmwareIndexUrl(const QUrl &url)
     m_firmwareIndexUrl = url;
 }
 
-ZigbeeIntegrationPlugin::FirmwareIndexEntry ZigbeeIntegrationPlugin::checkFirmwareAvailability(const QList<FirmwareIndexEntry> &index, quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelName) const
+void ZigbeeIntegrationPlugin::setFirmwareCacheBudget(qint64 budget)
+{
+    m_firmwareCacheBudget = budget;
+    if (m_firmwareCache) {
+        m_firmwareCache->setBudget(budget);
+    }
+}
+
+void ZigbeeIntegrationPlugin::setFirmwarePrefetchEnabled(bool enabled)
+{
+    m_firmwarePrefetchEnabled = enabled;
+}
+
+void ZigbeeIntegrationPlugin::setLocalFirmwareRepository(const QString &path)
+{
+    m_localFirmwareRepository = path;
+}
+
+void ZigbeeIntegrationPlugin::setImageNotifyWindow(int seconds)
+{
+    m_imageNotifyWindow = seconds;
+    if (m_otaScheduler) {
+        m_otaScheduler->setNotifyWindow(seconds);
+    }
+}
+
+void ZigbeeIntegrationPlugin::setMaximumOtaTransfers(int maximumTransfers)
+{
+    m_maximumOtaTransfers = maximumTransfers;
+    if (m_otaScheduler) {
+        m_otaScheduler->setMaximumTransfers(maximumTransfers);
+    }
+}
+
+ZigbeeIntegrationPlugin::FirmwareIndexEntry ZigbeeIntegrationPlugin::checkFirmwareAvailability(const ZigbeeFirmwareCatalog &catalog, quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelName) const
 {
     qCDebug(m_dc) << "Requesting OTA for" << manufacturerCode << imageType << currentFileVersion;
-    foreach (const FirmwareIndexEntry &image, index) {
-        if (image.manufacturerCode == manufacturerCode
-                && image.imageType == imageType
-                && image.fileVersion > currentFileVersion
-                && (image.minFileVersion == 0 || image.minFileVersion <= currentFileVersion)
-                && (image.maxFileVersion == 0 || image.maxFileVersion >= currentFileVersion)
-                && (image.modelId.isEmpty() || image.modelId == modelName)) {
-            qCDebug(m_dc) << "Found OTA for" << manufacturerCode << imageType << image.fileVersion;
-            return image;
-        }
+    FirmwareIndexEntry image = catalog.findUpdate(manufacturerCode, imageType, currentFileVersion, modelName);
+    if (image.fileVersion > 0) {
+        qCDebug(m_dc) << "Found OTA for" << manufacturerCode << imageType << image.fileVersion;
     }
-    return FirmwareIndexEntry();
+    return image;
 }
 
 void ZigbeeIntegrationPlugin::enableFirmwareUpdate(Thing *thing)
 {
     m_enabledFirmwareUpdates.append(thing);
-    thing->setStateValue("updateStatus", "updating");
+    thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "updating");
 }
 
 void ZigbeeIntegrationPlugin::updateFirmwareIndex()
 {
-    if (m_lastFirmwareIndexUpdate.isNull()) {
-        QFileInfo cacheFileInfo(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/zigbee-firmwares/" + m_firmwareIndexUrl.path());
-        if (cacheFileInfo.exists()) {
-            QFile cache(cacheFileInfo.absoluteFilePath());
-            if (cache.open(QFile::ReadOnly)) {
-                m_firmwareIndex = firmwareIndexFromJson(cache.readAll());
-                m_lastFirmwareIndexUpdate = cacheFileInfo.lastModified();
-            }
+    if (!m_firmwareIndexService) {
+        return;
+    }
+    // The network manager is owned by the core and outlives all plugins sharing the service
+    NetworkAccessManager *networkManager = hardwareManager()->networkManager();
+    m_firmwareIndexService->update([networkManager](const QNetworkRequest &request){
+        return networkManager->get(request);
+    });
+}
+
+void ZigbeeIntegrationPlugin::firmwareCatalogChanged()
+{
+    QSharedPointer<const ZigbeeFirmwareCatalog> catalog = firmwareCatalog();
+
+    // Nothing to report while the remote index has not been loaded, local images alone would make the
+    // remote ones look superseded. The cache manager waits for all plugins before pruning.
+    if (m_firmwareCache && m_firmwareIndexService && !m_firmwareIndexService->remoteCatalog()->isEmpty()) {
+        QSet<QString> fileNames;
+        foreach (const FirmwareIndexEntry &entry, catalog->entries()) {
+            fileNames.insert(firmwareFileName(entry));
+        }
+        m_firmwareCache->setIndexedImages(this, fileNames);
+    }
+
+    // A new index or local image might contain updates for devices which polled already
+    foreach (Thing *thing, m_firmwareQueries.keys()) {
+        const FirmwareQuery query = m_firmwareQueries.value(thing);
+        FirmwareIndexEntry info = catalog->findUpdate(query.manufacturerCode, query.imageType, query.fileVersion, query.modelName);
+        if (info.fileVersion > 0) {
+            m_availableFirmwares.insert(thing, info);
+            prefetchFirmware(thing, info);
         }
     }
+    updatePinnedFirmwares();
+}
 
-    if (m_lastFirmwareIndexUpdate.addDays(1) > QDateTime::currentDateTime()) {
+void ZigbeeIntegrationPlugin::otaImageNotifyDue(QObject *target)
+{
+    // The scheduler is shared by all plugins, only look at our own things
+    Thing *thing = static_cast<Thing*>(target);
+    if (!m_otaClusters.contains(thing)) {
         return;
     }
-    QNetworkRequest request(m_firmwareIndexUrl);
-    QNetworkReply *reply = hardwareManager()->networkManager()->get(request);
-    qCDebug(m_dc) << "Fetching firmware index...";
-    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
-    connect(reply, &QNetworkReply::finished, this, [=](){
-        if (reply->error() != QNetworkReply::NoError) {
-            qCWarning(m_dc) << "Unable to fetch firmware update index file. Zigbee device firmware updates won't work.";
-            return;
-        }
-        QByteArray data = reply->readAll();
-        m_firmwareIndex = firmwareIndexFromJson(data);
-        m_lastFirmwareIndexUpdate = QDateTime::currentDateTime();
-        QFileInfo cacheFileInfo(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/zigbee-firmwares/" + m_firmwareIndexUrl.path());
-        QDir cacheDir(cacheFileInfo.absolutePath());
-        if (!cacheDir.exists() && !cacheDir.mkpath(cacheFileInfo.absolutePath())) {
-            qCWarning(m_dc) << "Unable to create cache file path" << cacheFileInfo.absolutePath();
-            return;
-        }
-        QFile cache(cacheFileInfo.absoluteFilePath());
-        if (!cache.open(QFile::WriteOnly | QFile::Truncate)) {
-            qCWarning(m_dc) << "Unable to open cache file for writing" << cacheFileInfo.absoluteFilePath();
-            return;
+
+    OtaClusterState &state = m_otaClusters[thing];
+    if (!state.cluster || state.imageNotifyPending) {
+        return;
+    }
+
+    qCDebug(m_dc) << "Sending image notify to" << thing->name();
+    ZigbeeClusterReply *reply = state.cluster->sendImageNotify();
+    state.imageNotifyPending = true;
+    connect(reply, &ZigbeeClusterReply::finished, thing, [this, reply, thing](){
+        qCDebug(m_dc) << "Image notify command finished" << reply->error();
+        if (m_otaClusters.contains(thing)) {
+            m_otaClusters[thing].imageNotifyPending = false;
         }
-        cache.write(data);
-        cache.close();
     });
 }
 
+void ZigbeeIntegrationPlugin::otaTransferAdmitted(QObject *transfer)
+{
+    // The scheduler is shared by all plugins, only look at our own things
+    Thing *thing = static_cast<Thing*>(transfer);
+    if (!m_otaClusters.contains(thing)) {
+        return;
+    }
+
+    ZigbeeClusterOta *otaCluster = m_otaClusters.value(thing).cluster;
+    if (!otaCluster || !m_enabledFirmwareUpdates.contains(thing)) {
+        m_otaScheduler->finishTransfer(thing);
+        return;
+    }
+
+    // Make the device query the image again now that it's its turn
+    qCDebug(m_dc) << "Firmware update slot available. Sending image notify to" << thing->name();
+    otaCluster->sendImageNotify();
+}
+
+QSharedPointer<const ZigbeeFirmwareCatalog> ZigbeeIntegrationPlugin::firmwareCatalog() const
+{
+    if (!m_firmwareIndexService) {
+        return QSharedPointer<const ZigbeeFirmwareCatalog>(new ZigbeeFirmwareCatalog());
+    }
+    return m_firmwareIndexService->catalog();
+}
+
 ZigbeeIntegrationPlugin::FirmwareIndexEntry ZigbeeIntegrationPlugin::firmwareInfo(quint16 manufacturerId, quint16 imageType, quint32 fileVersion) const
 {
-    foreach (const FirmwareIndexEntry &entry, m_firmwareIndex) {
-        if (entry.manufacturerCode == manufacturerId
-                && entry.imageType == imageType
-                && entry.fileVersion == fileVersion) {
-            return entry;
+    return firmwareCatalog()->find(manufacturerId, imageType, fileVersion);
+}
+
+ZigbeeIntegrationPlugin::FirmwareIndexEntry ZigbeeIntegrationPlugin::otaImage(Thing *thing, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion)
+{
+    ZigbeeOtaSession *session = m_otaSessions.value(thing);
+    if (session && session->matches(manufacturerCode, imageType, fileVersion)) {
+        return session->image();
+    }
+
+    FirmwareIndexEntry info = firmwareInfo(manufacturerCode, imageType, fileVersion);
+    if (info.fileVersion == 0) {
+        // The index might have changed since an interrupted transfer has been started
+        FirmwareIndexEntry storedInfo = storedOtaImage(thing);
+        if (storedInfo.manufacturerCode == manufacturerCode && storedInfo.imageType == imageType && storedInfo.fileVersion == fileVersion) {
+            info = storedInfo;
         }
     }
-    return FirmwareIndexEntry();
+    return info;
+}
+
+ZigbeeOtaSession *ZigbeeIntegrationPlugin::otaSession(Thing *thing, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion)
+{
+    ZigbeeOtaSession *session = m_otaSessions.value(thing);
+    if (session && session->matches(manufacturerCode, imageType, fileVersion)) {
+        return session;
+    }
+    closeOtaSession(thing);
+
+    FirmwareIndexEntry info = otaImage(thing, manufacturerCode, imageType, fileVersion);
+    if (info.fileVersion == 0) {
+        qCWarning(m_dc) << "No firmware index entry for requested image" << manufacturerCode << imageType << fileVersion;
+        return nullptr;
+    }
+    session = new ZigbeeOtaSession(info, firmwareFileName(info));
+    if (!session->open()) {
+        delete session;
+        return nullptr;
+    }
+    qCDebug(m_dc) << "Opened OTA session for" << thing->name() << "with image" << manufacturerCode << imageType << fileVersion;
+    m_otaSessions.insert(thing, session);
+    storeOtaSession(thing, session);
+    m_firmwareCache->touch(firmwareFileName(info));
+    updatePinnedFirmwares();
+    return session;
+}
+
+void ZigbeeIntegrationPlugin::closeOtaSession(Thing *thing)
+{
+    ZigbeeOtaSession *session = m_otaSessions.take(thing);
+    if (session) {
+        qCDebug(m_dc) << "Closing OTA session for" << thing->name();
+        writeOtaTelemetry(thing, session, true);
+        updateOtaTelemetryStates(thing, nullptr);
+        delete session;
+        updatePinnedFirmwares();
+    }
+}
+
+void ZigbeeIntegrationPlugin::storeOtaSession(Thing *thing, ZigbeeOtaSession *session)
+{
+    FirmwareIndexEntry info = session->image();
+    pluginStorage()->beginGroup("OtaSessions");
+    pluginStorage()->beginGroup(thing->id().toString());
+    pluginStorage()->setValue("manufacturerCode", info.manufacturerCode);
+    pluginStorage()->setValue("imageType", info.imageType);
+    pluginStorage()->setValue("fileVersion", info.fileVersion);
+    pluginStorage()->setValue("fileSize", info.fileSize);
+    pluginStorage()->setValue("modelId", info.modelId);
+    pluginStorage()->setValue("url", info.url);
+    pluginStorage()->setValue("sha512", info.sha512);
+    pluginStorage()->setValue("offset", session->offset());
+    pluginStorage()->endGroup();
+    pluginStorage()->endGroup();
+    session->setStoredOffset(session->offset());
+
+    writeOtaTelemetry(thing, session, false);
+}
+
+void ZigbeeIntegrationPlugin::removeStoredOtaSession(Thing *thing)
+{
+    pluginStorage()->beginGroup("OtaSessions");
+    pluginStorage()->remove(thing->id().toString());
+    pluginStorage()->endGroup();
+}
+
+ZigbeeIntegrationPlugin::FirmwareIndexEntry ZigbeeIntegrationPlugin::storedOtaImage(Thing *thing)
+{
+    FirmwareIndexEntry info;
+    pluginStorage()->beginGroup("OtaSessions");
+    if (pluginStorage()->childGroups().contains(thing->id().toString())) {
+        pluginStorage()->beginGroup(thing->id().toString());
+        info.manufacturerCode = pluginStorage()->value("manufacturerCode").toUInt();
+        info.imageType = pluginStorage()->value("imageType").toUInt();
+        info.fileVersion = pluginStorage()->value("fileVersion").toUInt();
+        info.fileSize = pluginStorage()->value("fileSize").toUInt();
+        info.modelId = pluginStorage()->value("modelId").toString();
+        info.url = pluginStorage()->value("url").toUrl();
+        info.sha512 = pluginStorage()->value("sha512").toByteArray();
+        pluginStorage()->endGroup();
+    }
+    pluginStorage()->endGroup();
+    return info;
+}
+
+void ZigbeeIntegrationPlugin::restoreOtaSession(Thing *thing)
+{
+    FirmwareIndexEntry info = storedOtaImage(thing);
+    if (info.fileVersion == 0 || m_enabledFirmwareUpdates.contains(thing)) {
+        return;
+    }
+
+    pluginStorage()->beginGroup("OtaSessions");
+    pluginStorage()->beginGroup(thing->id().toString());
+    quint32 offset = pluginStorage()->value("offset").toUInt();
+    pluginStorage()->endGroup();
+    pluginStorage()->endGroup();
+
+    qCDebug(m_dc) << "Resuming interrupted firmware update for" << thing->name() << "at offset" << offset << "of" << info.fileSize;
+    m_enabledFirmwareUpdates.append(thing);
+    m_availableFirmwares.insert(thing, info);
+    updatePinnedFirmwares();
+    thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateStatus), "updating");
+    if (info.fileSize > 0) {
+        thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateProgress), qRound(100.0 * offset / info.fileSize));
+    }
+}
+
+void ZigbeeIntegrationPlugin::updateOtaTelemetryStates(Thing *thing, ZigbeeOtaTelemetry *telemetry)
+{
+    if (stateTypeId(thing, ZigbeeThingClassIds::StateUpdateTransferRate).isNull()) {
+        return;
+    }
+    thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateTransferRate), telemetry ? qRound(telemetry->bytesPerSecond() * 10) / 10.0 : 0);
+    thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateTimeRemaining), telemetry ? qMax(0, telemetry->secondsRemaining()) : 0);
+    thing->setStateValue(stateTypeId(thing, ZigbeeThingClassIds::StateUpdateRetransmissions), telemetry ? telemetry->retransmissions() : 0);
+}
+
+QString ZigbeeIntegrationPlugin::otaTelemetryFileName(Thing *thing) const
+{
+    return QString("%1/zigbee-ota-telemetry/%2.json")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+            .arg(thing->id().toString().remove('{').remove('}'));
+}
+
+void ZigbeeIntegrationPlugin::writeOtaTelemetry(Thing *thing, ZigbeeOtaSession *session, bool finished)
+{
+    FirmwareIndexEntry info = session->image();
+    QVariantMap image;
+    image.insert("manufacturerCode", info.manufacturerCode);
+    image.insert("imageType", info.imageType);
+    image.insert("fileVersion", info.fileVersion);
+    image.insert("fileSize", info.fileSize);
+
+    QVariantMap map = session->telemetry()->toVariantMap();
+    map.insert("thingId", thing->id().toString());
+    map.insert("thingName", thing->name());
+    map.insert("image", image);
+    map.insert("finished", finished);
+
+    QFileInfo fileInfo(otaTelemetryFileName(thing));
+    if (!QDir().mkpath(fileInfo.absolutePath())) {
+        qCWarning(m_dc) << "Error creating path for OTA telemetry" << fileInfo.absolutePath();
+        return;
+    }
+    QSaveFile file(fileInfo.absoluteFilePath());
+    if (!file.open(QFile::WriteOnly) || file.write(QJsonDocument::fromVariant(map).toJson()) < 0 || !file.commit()) {
+        qCWarning(m_dc) << "Error writing OTA telemetry" << file.errorString();
+        return;
+    }
+    if (finished) {
+        qCDebug(m_dc) << "OTA transfer statistics for" << thing->name() << "written to" << fileInfo.absoluteFilePath();
+    }
 }
 
 QString ZigbeeIntegrationPlugin::firmwareFileName(const ZigbeeIntegrationPlugin::FirmwareIndexEntry &info) const
@@ -1553,197 +2017,243 @@ QString ZigbeeIntegrationPlugin::firmwareFileName(const ZigbeeIntegrationPlugin:
             .arg(info.url.fileName());
 }
 
-FetchFirmwareReply *ZigbeeIntegrationPlugin::fetchFirmware(const ZigbeeIntegrationPlugin::FirmwareIndexEntry &info)
+FetchFirmwareReply *ZigbeeIntegrationPlugin::fetchFirmware(const ZigbeeIntegrationPlugin::FirmwareIndexEntry &info, QObject *waiter)
 {
-    FetchFirmwareReply *reply = new FetchFirmwareReply(this);
-    QFuture<bool> future;
-    qCDebug(m_dc) << "Downloading firmware from" << info.url.toString();
-    QNetworkRequest request(info.url);
+    // If multiple devices request the same image at the same time, they all wait for the same download
+    FirmwareDownloadKey key = {info.manufacturerCode, info.imageType, info.fileVersion};
+    FetchFirmwareReply *reply = m_pendingFirmwareDownloads.value(key);
+    if (reply) {
+        qCDebug(m_dc) << "Firmware" << info.url.toString() << "is already being downloaded";
+        reply->addWaiter(waiter);
+        return reply;
+    }
+
+    reply = new FetchFirmwareReply(this);
+    reply->addWaiter(waiter);
+    m_pendingFirmwareDownloads.insert(key, reply);
+    connect(reply, &FetchFirmwareReply::finished, this, [this, key](){
+        m_pendingFirmwareDownloads.remove(key);
+    });
+
+    downloadFirmware(info, info.url, reply);
+    return reply;
+}
+
+void ZigbeeIntegrationPlugin::downloadFirmware(const FirmwareIndexEntry &info, const QUrl &url, FetchFirmwareReply *reply)
+{
+    QFileInfo fileInfo(firmwareFileName(info));
+    QDir path(fileInfo.absolutePath());
+    if (!path.exists() && !path.mkpath(fileInfo.absolutePath())) {
+        qCWarning(m_dc) << "Error creating cache path for firmware" << fileInfo.absolutePath();
+        emit reply->finished();
+        return;
+    }
+
+    if (url.isLocalFile()) {
+        // Images from the local repository go through the same extraction and checks as downloaded ones
+        qCDebug(m_dc) << "Importing firmware from" << url.toLocalFile();
+        QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+        connect(reply, &FetchFirmwareReply::cancelRequested, reply, [this, cancelled, url](){
+            qCDebug(m_dc) << "Nobody waits for firmware" << url.toLocalFile() << "any more. Cancelling import.";
+            cancelled->storeRelease(1);
+        });
+        QFutureWatcher<FirmwareImportResult> *watcher = new QFutureWatcher<FirmwareImportResult>(reply);
+        connect(watcher, &QFutureWatcher<FirmwareImportResult>::finished, reply, [=](){
+            FirmwareImportResult result = watcher->result();
+            if (!result.errorString.isEmpty()) {
+                qCWarning(m_dc) << "Unable to import firmware" << url.toLocalFile() << result.errorString;
+            } else {
+                m_firmwareVerifier.store(fileInfo.absoluteFilePath(), result.sha512);
+                m_firmwareCache->touch(fileInfo.absoluteFilePath());
+            }
+            emit reply->finished();
+        });
+        watcher->setFuture(QtConcurrent::run(importFirmwareFile, info, url.toLocalFile(), fileInfo.absoluteFilePath(), cancelled));
+        return;
+    }
+
+    // The image is extracted and written to disk while it is being downloaded
+    QSharedPointer<ZigbeeOtaImageWriter> writer(new ZigbeeOtaImageWriter(info, fileInfo.absoluteFilePath()));
+    if (!writer->open()) {
+        qCWarning(m_dc) << "Error opening firmware cache file for writing:" << writer->errorString();
+        emit reply->finished();
+        return;
+    }
+
+    qCDebug(m_dc) << "Downloading firmware from" << url.toString();
+    QNetworkRequest request(url);
     QNetworkReply *networkReply = hardwareManager()->networkManager()->get(request);
 
     connect(networkReply, &QNetworkReply::finished, networkReply, &QNetworkReply::deleteLater);
+    connect(reply, &FetchFirmwareReply::cancelRequested, networkReply, [this, networkReply, url](){
+        qCDebug(m_dc) << "Nobody waits for firmware" << url.toString() << "any more. Cancelling download.";
+        networkReply->abort();
+    });
+    connect(networkReply, &QNetworkReply::readyRead, this, [=](){
+        if (networkReply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
+            return;
+        }
+        if (!writer->write(networkReply->readAll())) {
+            networkReply->abort();
+        }
+    });
     connect(networkReply, &QNetworkReply::finished, this, [=](){
+        if (!writer->errorString().isEmpty()) {
+            qCWarning(m_dc) << "Unable to extract image:" << writer->errorString();
+            emit reply->finished();
+            return;
+        }
         if (networkReply->error() != QNetworkReply::NoError) {
-            qCWarning(m_dc) << "Error downloading firmware" << info.url.toString();
+            qCWarning(m_dc) << "Error downloading firmware" << url.toString();
+            writer->cancel();
             emit reply->finished();
             return;
         }
         if (networkReply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
-            QUrl newUrl = networkReply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+            QUrl newUrl = url.resolved(networkReply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl());
             qCDebug(m_dc) << "Firmware download redirected to" << newUrl;
-            FirmwareIndexEntry newInfo = info;
-            newInfo.url = newUrl;
-            FetchFirmwareReply *newReply = fetchFirmware(newInfo);
-            connect(newReply, &FetchFirmwareReply::finished, reply, &FetchFirmwareReply::finished);
-            return;
-        }
-        QFileInfo fileInfo(firmwareFileName(info));
-        QDir path(fileInfo.absolutePath());
-        if (!path.exists() && !path.mkpath(fileInfo.absolutePath())) {
-            qCWarning(m_dc) << "Error creating cache path for firmware" << fileInfo.absolutePath();
-            emit reply->finished();
+            writer->cancel();
+            // Keep the index entry as is, the cache file name is derived from the url in the index
+            downloadFirmware(info, newUrl, reply);
             return;
         }
-        QByteArray data = extractImage(info, networkReply->readAll());
-        if (data.isEmpty()) {
-            qCWarning(m_dc) << "Unable to extract image";
+
+        if (!writer->write(networkReply->readAll()) || !writer->finish()) {
+            qCWarning(m_dc) << "Unable to extract image:" << writer->errorString();
             emit reply->finished();
             return;
         }
+        ZigbeeOtaImageHeader header = writer->header();
+        ZigbeeClusterOta::FileVersion parsedVersion = ZigbeeClusterOta::parseFileVersion(header.fileVersion);
+        qCDebug(m_dc) << "Header version:" << header.headerVersion;
+        qCDebug(m_dc) << "Header length:" << header.headerLength;
+        qCDebug(m_dc) << "Field control:" << header.fieldControl;
+        qCDebug(m_dc) << "Manufacturer code:" << header.manufacturerCode;
+        qCDebug(m_dc) << "Image type:" << header.imageType;
+        qCDebug(m_dc) << "File version:" << header.fileVersion << QString("%0.%1.%2.%3").arg(parsedVersion.applicationRelease).arg(parsedVersion.applicationBuild).arg(parsedVersion.stackRelease).arg(parsedVersion.stackBuild);
+        qCDebug(m_dc) << "Zigbee Stack version:" << header.zigbeeStackVersion;
+        qCDebug(m_dc) << "Header string:" << header.headerString;
+        qCDebug(m_dc) << "Image size:" << header.totalImageSize;
+        qCDebug(m_dc) << "Security credentials version:" << header.securityCredentialVersion;
+        qCDebug(m_dc) << "Min HW version:" << header.minimumHardwareVersion << "Max HW version:" << header.maximumHardwareVersion;
+        qCDebug(m_dc) << "Firmware image stored in" << fileInfo.absoluteFilePath();
+        m_firmwareVerifier.store(fileInfo.absoluteFilePath(), writer->sha512());
+        m_firmwareCache->touch(fileInfo.absoluteFilePath());
+        emit reply->finished();
+    });
+}
 
-        QFile file(fileInfo.absoluteFilePath());
-        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
-            qCWarning(m_dc) << "Error opening firmware cache file for writing" << fileInfo.absoluteFilePath();
-            emit reply->finished();
+void ZigbeeIntegrationPlugin::prefetchFirmware(Thing *thing, const FirmwareIndexEntry &info)
+{
+    if (!m_firmwarePrefetchEnabled) {
+        return;
+    }
+
+    verifyFirmwareFile(info, thing, [this, thing, info](bool valid){
+        if (valid) {
             return;
         }
-        file.write(data);
-        file.close();
-        emit reply->finished();
+        qCDebug(m_dc) << "Prefetching firmware" << info.url.toString() << "for" << thing->name();
+        FetchFirmwareReply *reply = fetchFirmware(info, thing);
+        connect(reply, &FetchFirmwareReply::finished, thing, [this, thing, info](){
+            verifyFirmwareFile(info, thing, [this, thing](bool valid){
+                if (valid) {
+                    qCDebug(m_dc) << "Firmware for" << thing->name() << "is ready to be installed";
+                } else {
+                    qCWarning(m_dc) << "Failed to prefetch firmware for" << thing->name();
+                }
+            });
+        });
     });
-    return reply;
 }
 
-bool ZigbeeIntegrationPlugin::firmwareFileExists(const ZigbeeIntegrationPlugin::FirmwareIndexEntry &info) const
+void ZigbeeIntegrationPlugin::verifyFirmwareFile(const FirmwareIndexEntry &info, QObject *context, std::function<void(bool)> callback)
 {
-    QFile file(firmwareFileName(info));
-    if (!file.exists()) {
+    QFileInfo fileInfo(firmwareFileName(info));
+    if (!fileInfo.exists()) {
         qCDebug(m_dc) << "File does not exist";
-        return false;
+        callback(false);
+        return;
     }
-    if (file.size() != info.fileSize) {
-        qCDebug(m_dc) << "File size not matching:" << file.size() << "!=" << info.fileSize;
-        return false;
+    if (fileInfo.size() != info.fileSize) {
+        qCDebug(m_dc) << "File size not matching:" << fileInfo.size() << "!=" << info.fileSize;
+        callback(false);
+        return;
     }
-    if (!file.open(QFile::ReadOnly)) {
-        return false;
+    if (info.sha512.isEmpty()) {
+        callback(true);
+        return;
     }
-    if (!info.sha512.isEmpty()) {
-        QByteArray hash = QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha512);
-        if (info.sha512 != hash.toHex()) {
+
+    QString fileName = fileInfo.absoluteFilePath();
+    QByteArray hash = m_firmwareVerifier.cachedSha512(fileName);
+    if (!hash.isEmpty()) {
+        if (hash != info.sha512) {
             qCDebug(m_dc) << "SHA512 verification failed";
-            return false;
         }
-        qCDebug(m_dc) << "SHA512 verified successfully";
+        callback(hash == info.sha512);
+        return;
     }
-    file.close();
 
-    return true;
+    // Hashing a large image takes a while, keep it off the event loop all zigbee plugins share
+    QFutureWatcher<ZigbeeFirmwareVerifier::Checksum> *watcher = new QFutureWatcher<ZigbeeFirmwareVerifier::Checksum>(context);
+    connect(watcher, &QFutureWatcher<ZigbeeFirmwareVerifier::Checksum>::finished, context, [this, watcher, fileName, info, callback](){
+        ZigbeeFirmwareVerifier::Checksum checksum = watcher->result();
+        watcher->deleteLater();
+        if (checksum.sha512.isEmpty() || checksum.sha512 != info.sha512) {
+            qCDebug(m_dc) << "SHA512 verification failed";
+            callback(false);
+            return;
+        }
+        qCDebug(m_dc) << "SHA512 verified successfully";
+        m_firmwareVerifier.store(fileName, checksum);
+        callback(true);
+    });
+    watcher->setFuture(QtConcurrent::run(ZigbeeFirmwareVerifier::calculateChecksum, fileName));
 }
 
-QByteArray ZigbeeIntegrationPlugin::extractImage(const FirmwareIndexEntry &info, const QByteArray &data) const
+void ZigbeeIntegrationPlugin::updatePinnedFirmwares()
 {
-    QDataStream stream(data);
-    stream.setByteOrder(QDataStream::LittleEndian);
-
-    // Trying to find the OTA upgrade file identifier 0x0BEEF11E
-    bool found = false;
-    quint32 otaFileIdentifier = 0x0BEEF11E;
-    quint8 searchPos = 0;
-    quint64 startPos = 0;
-    while (!stream.atEnd()) {
-        quint8 tmp;
-        stream >> tmp;
-        if (tmp == (otaFileIdentifier & (0xff << (searchPos * 8))) >> (searchPos * 8)) {
-            searchPos++;
-        } else {
-            searchPos = 0;
-        }
-        if (searchPos == 4) {
-            found = true;
-            startPos -= 3;
-            break;
-        }
-        startPos++;
-    }
-
-    if (!found) {
-        qCDebug(m_dc) << "Image identifier not found in download.";
-        return QByteArray();
-    }
-
-    quint16 headerVersion, headerLength, fieldControl, manufacturerCode, imageType, zigbeeStackVersion;
-    quint32 fileVersion, totalImageSize;
-    stream >> headerVersion >> headerLength >> fieldControl >> manufacturerCode >> imageType >> fileVersion >> zigbeeStackVersion;
-    char headerStr[32];
-    stream.readRawData(headerStr, 32);
-    QByteArray headerString(headerStr, 32);
-    stream >> totalImageSize;
-
-    quint8 securityCredentialVersion = 0;
-    if (fieldControl & 0x01) {
-        stream >> securityCredentialVersion;
-    }
-
-    ZigbeeAddress upgradeFileDestination;
-    if (fieldControl & 0x02) {
-        quint64 destinationAddr;
-        stream >> destinationAddr;
-        upgradeFileDestination = ZigbeeAddress(destinationAddr);
-    }
-
-    quint16 minimumHardwareVersion = 0;
-    quint16 maximumHardwareVersion = 0;
-    if (fieldControl & 0x04) {
-        stream >> minimumHardwareVersion >> maximumHardwareVersion;
+    if (!m_firmwareCache) {
+        return;
     }
 
-    qCDebug(m_dc) << "Header version:" << headerVersion;
-    qCDebug(m_dc) << "Header length:" << headerLength;
-    qCDebug(m_dc) << "Field control:" << fieldControl;
-    qCDebug(m_dc) << "Manufacturer code:" << manufacturerCode;
-    qCDebug(m_dc) << "Image type:" << imageType;
-    ZigbeeClusterOta::FileVersion parsedVersion = ZigbeeClusterOta::parseFileVersion(fileVersion);
-    qCDebug(m_dc) << "File version:" << fileVersion << QString("%0.%1.%2.%3").arg(parsedVersion.applicationRelease).arg(parsedVersion.applicationBuild).arg(parsedVersion.stackRelease).arg(parsedVersion.stackBuild);
-    qCDebug(m_dc) << "Zigbee Stack version:" << zigbeeStackVersion;
-    qCDebug(m_dc) << "Header string:" << headerString;
-    qCDebug(m_dc) << "Image size:" << totalImageSize;
-    qCDebug(m_dc) << "Security credentials version:" << securityCredentialVersion;
-    qCDebug(m_dc) << "Min HW version:" << minimumHardwareVersion << "Max HW version:" << maximumHardwareVersion;
-
-    qCDebug(m_dc) << "Download file size:" << data.size() << "Image start position:" << startPos;
-
-    if (totalImageSize != info.fileSize || data.size() - startPos < totalImageSize) {
-        qCWarning(m_dc) << "Image file size not matching";
-        return QByteArray();
+    QSet<QString> fileNames;
+    foreach (const FirmwareIndexEntry &info, m_availableFirmwares) {
+        fileNames.insert(firmwareFileName(info));
     }
-    if (manufacturerCode != info.manufacturerCode) {
-        qCWarning(m_dc) << "Manufacturer code not matching in downloaded image" << manufacturerCode << "!=" << info.manufacturerCode;
-        return QByteArray();
+    foreach (ZigbeeOtaSession *session, m_otaSessions) {
+        fileNames.insert(firmwareFileName(session->image()));
     }
-    if (imageType != info.imageType) {
-        qCWarning(m_dc) << "Image type not matching in downloaded image" << imageType << "!=" << info.imageType;
-        return QByteArray();
-    }
-    qCDebug(m_dc) << "Image data:" << data.mid(startPos, 16).toHex();
-    return data.mid(startPos, totalImageSize);
+    m_firmwareCache->setPinnedImages(this, fileNames);
 }
 
 QList<ZigbeeIntegrationPlugin::FirmwareIndexEntry> ZigbeeIntegrationPlugin::firmwareIndexFromJson(const QByteArray &data) const
 {
-    QList<ZigbeeIntegrationPlugin::FirmwareIndexEntry> ret;
-
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(m_dc) << "Unable to parse firmware update index.";
-        return ret;
-    }
-
-    foreach (const QVariant &entryVariant, jsonDoc.toVariant().toList()) {
-        QVariantMap map = entryVariant.toMap();
-        FirmwareIndexEntry entry;
-        entry.manufacturerCode = map.value("manufacturerCode").toUInt();
-        entry.imageType = map.value("imageType").toUInt();
-        entry.fileVersion = map.value("fileVersion").toUInt();
-        entry.minFileVersion = map.value("minFileVersion").toUInt();
-        entry.maxFileVersion = map.value("maxFileVersion").toUInt();
-        entry.fileSize = map.value("fileSize").toUInt();
-        entry.url = map.value("url").toUrl();
-        entry.modelId = map.value("modelId").toString();
-        entry.sha512 = map.value("sha512").toByteArray();
-        ret.append(entry);
+    ZigbeeFirmwareIndexReader reader(data);
+    QList<FirmwareIndexEntry> ret = reader.read([](FirmwareIndexEntry *entry, const QLatin1String &key, const ZigbeeFirmwareIndexReader::Value &value){
+        if (key == QLatin1String("manufacturerCode")) {
+            entry->manufacturerCode = value.toUInt();
+        } else if (key == QLatin1String("imageType")) {
+            entry->imageType = value.toUInt();
+        } else if (key == QLatin1String("fileVersion")) {
+            entry->fileVersion = value.toUInt();
+        } else if (key == QLatin1String("minFileVersion")) {
+            entry->minFileVersion = value.toUInt();
+        } else if (key == QLatin1String("maxFileVersion")) {
+            entry->maxFileVersion = value.toUInt();
+        } else if (key == QLatin1String("fileSize")) {
+            entry->fileSize = value.toUInt();
+        } else if (key == QLatin1String("url")) {
+            entry->url = QUrl(value.toString());
+        } else if (key == QLatin1String("modelId")) {
+            entry->modelId = value.toString();
+        } else if (key == QLatin1String("sha512")) {
+            entry->sha512 = value.toByteArray();
+        }
+    });
+    if (reader.hasError()) {
+        qCWarning(m_dc) << "Unable to parse firmware update index:" << reader.errorString();
     }
     return ret;
-
 }
@@ -36,10 +36,22 @@
 #include "hardware/zigbee/zigbeehardwareresource.h"
 #include "plugintimer.h"
 
+#include "zigbeefirmwarecatalog.h"
+#include "zigbeeotasession.h"
+#include "zigbeenoderegistry.h"
+#include "zigbeethingclassids.h"
+#include "zigbeestatebinder.h"
+#include "zigbeeotascheduler.h"
+#include "zigbeefirmwareverifier.h"
+#include "zigbeefirmwareindexservice.h"
+#include "zigbeefirmwarecachemanager.h"
+
 #include <zcl/lighting/zigbeeclustercolorcontrol.h>
 #include <zcl/ota/zigbeeclusterota.h>
 
-#include <QFuture>
+#include <functional>
+#include <QPointer>
+#include <QDateTime>
 
 class FetchFirmwareReply;
 
@@ -48,18 +60,7 @@ class ZigbeeIntegrationPlugin: public IntegrationPlugin, public ZigbeeHandler
     Q_OBJECT
 
 public:
-    class FirmwareIndexEntry {
-    public:
-        quint16 manufacturerCode = 0;
-        quint16 imageType = 0;
-        quint32 fileVersion = 0;
-        quint32 minFileVersion = 0;
-        quint32 maxFileVersion = 0;
-        quint32 fileSize = 0;
-        QString modelId;
-        QUrl url;
-        QByteArray sha512;
-    };
+    typedef ZigbeeFirmwareIndexEntry FirmwareIndexEntry;
 
     explicit ZigbeeIntegrationPlugin(ZigbeeHardwareResource::HandlerType handlerType, const QLoggingCategory &loggingCategory);
     virtual ~ZigbeeIntegrationPlugin();
@@ -70,9 +71,17 @@ public:
 
 protected:
     bool manageNode(Thing *thing);
+    // The thing on the lowest endpoint of the node
     Thing *thingForNode(ZigbeeNode *node);
     ZigbeeNode *nodeForThing(Thing *thing);
 
+    // Type ids of the common params, states and actions, resolved once in init()
+    ParamTypeId paramTypeId(Thing *thing, ZigbeeThingClassIds::Param param) const;
+    StateTypeId stateTypeId(Thing *thing, ZigbeeThingClassIds::State state) const;
+    ActionTypeId actionTypeId(Thing *thing, ZigbeeThingClassIds::Action action) const;
+    // The endpoint given by the thing's endpointId param, or endpoint 0 for things without that param
+    ZigbeeNodeEndpoint *endpointForThing(Thing *thing);
+
     void createThing(const ThingClassId &thingClassId, ZigbeeNode *node, const ParamList &additionalParams = ParamList());
 
     void bindCluster(ZigbeeNodeEndpoint *endpoint, quint16 clusterId);
@@ -137,23 +146,67 @@ protected:
     // To support OTA updates, set the firmware update index url and override the parsing.
     // This base class will take care for fetching, caching and managing.
     void setFirmwareIndexUrl(const QUrl &url);
+
+    // Images placed in this directory are offered in addition to the ones from the index url and take
+    // precedence over them. Defaults to zigbee-firmwares in the application data location. The directory
+    // is scanned once for all plugins sharing the index url, the one set last is used.
+    void setLocalFirmwareRepository(const QString &path);
     virtual QList<FirmwareIndexEntry> firmwareIndexFromJson(const QByteArray &data) const;
 
-    FirmwareIndexEntry checkFirmwareAvailability(const QList<FirmwareIndexEntry> &index, quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelName) const;
+    FirmwareIndexEntry checkFirmwareAvailability(const ZigbeeFirmwareCatalog &catalog, quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelName) const;
     void enableFirmwareUpdate(Thing *thing);
 
+    // Number of OTA transfers allowed to run at the same time in one zigbee network. This limit is shared by all zigbee plugins.
+    void setMaximumOtaTransfers(int maximumTransfers);
+
+    // Image notify commands of all zigbee plugins are spread randomly over this window, in seconds
+    void setImageNotifyWindow(int seconds);
+
+    // Maximum disk space used by downloaded firmware images, in bytes. This budget is shared by all zigbee plugins.
+    void setFirmwareCacheBudget(qint64 budget);
+
+    // Download and verify available updates in the background, before the user enables them, so the
+    // transfer can start as soon as the device polls next. Enabled by default.
+    void setFirmwarePrefetchEnabled(bool enabled);
+
 private slots:
     virtual void updateFirmwareIndex();
+    void otaTransferAdmitted(QObject *transfer);
+    void otaImageNotifyDue(QObject *target);
+    void firmwareCatalogChanged();
 
 private:
+    QSharedPointer<const ZigbeeFirmwareCatalog> firmwareCatalog() const;
     FirmwareIndexEntry firmwareInfo(quint16 manufacturerId, quint16 imageType, quint32 fileVersion) const;
     QString firmwareFileName(const FirmwareIndexEntry &info) const;
-    FetchFirmwareReply *fetchFirmware(const FirmwareIndexEntry &info);
-    bool firmwareFileExists(const FirmwareIndexEntry &info) const;
-    QByteArray extractImage(const FirmwareIndexEntry &info, const QByteArray &data) const;
+    FetchFirmwareReply *fetchFirmware(const FirmwareIndexEntry &info, QObject *waiter);
+    void downloadFirmware(const FirmwareIndexEntry &info, const QUrl &url, FetchFirmwareReply *reply);
+    // Checks size and checksum of a cached image. Unknown checksums are calculated in a worker thread, the callback
+    // is always called on the main thread. It is not called at all if the context is destroyed in the meantime.
+    void verifyFirmwareFile(const FirmwareIndexEntry &info, QObject *context, std::function<void(bool valid)> callback);
+    void updatePinnedFirmwares();
+    void prefetchFirmware(Thing *thing, const FirmwareIndexEntry &info);
+
+    // The image of a transfer, also if the index doesn't list it any more since the transfer has been started
+    FirmwareIndexEntry otaImage(Thing *thing, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion);
+    ZigbeeOtaSession *otaSession(Thing *thing, quint16 manufacturerCode, quint16 imageType, quint32 fileVersion);
+    void closeOtaSession(Thing *thing);
+
+    // Running transfers are kept in the plugin storage so they can be resumed after a restart
+    void storeOtaSession(Thing *thing, ZigbeeOtaSession *session);
+    void removeStoredOtaSession(Thing *thing);
+    FirmwareIndexEntry storedOtaImage(Thing *thing);
+    void restoreOtaSession(Thing *thing);
+
+    // Transfer statistics are published as states, if the thing class has them, and dumped as json
+    void updateOtaTelemetryStates(Thing *thing, ZigbeeOtaTelemetry *telemetry);
+    QString otaTelemetryFileName(Thing *thing) const;
+    void writeOtaTelemetry(Thing *thing, ZigbeeOtaSession *session, bool finished);
 
 private:
-    QHash<Thing*, ZigbeeNode*> m_thingNodes;
+    ZigbeeNodeRegistry m_thingNodes;
+    ZigbeeThingClassIds m_thingClassIds;
+    ZigbeeStateBinder *m_stateBinder = nullptr;
 
     ZigbeeHardwareResource::HandlerType m_handlerType = ZigbeeHardwareResource::HandlerTypeVendor;
     QLoggingCategory m_dc;
@@ -182,9 +235,46 @@ private:
 
     // OTA
     QList<Thing*> m_enabledFirmwareUpdates;
+    QHash<Thing*, ZigbeeOtaSession*> m_otaSessions;
+    struct OtaClusterState {
+        QPointer<ZigbeeClusterOta> cluster;
+        bool imageNotifyPending = false;
+        QDateTime lastFirmwareCheck;
+    };
+    QHash<Thing*, OtaClusterState> m_otaClusters;
+    ZigbeeOtaScheduler *m_otaScheduler = nullptr;
+    int m_maximumOtaTransfers = 0;
+    int m_imageNotifyWindow = -1;
+    QHash<Thing*, FirmwareIndexEntry> m_availableFirmwares;
+    ZigbeeFirmwareCacheManager *m_firmwareCache = nullptr;
+    qint64 m_firmwareCacheBudget = 0;
+
+    // The last image query of each thing, used to look for updates again when the index changes
+    struct FirmwareQuery {
+        quint16 manufacturerCode;
+        quint16 imageType;
+        quint32 fileVersion;
+        QString modelName;
+    };
+    QHash<Thing*, FirmwareQuery> m_firmwareQueries;
+    bool m_firmwarePrefetchEnabled = true;
+
+    struct FirmwareDownloadKey {
+        quint16 manufacturerCode;
+        quint16 imageType;
+        quint32 fileVersion;
+        bool operator==(const FirmwareDownloadKey &other) const {
+            return manufacturerCode == other.manufacturerCode && imageType == other.imageType && fileVersion == other.fileVersion;
+        }
+    };
+    friend uint qHash(const FirmwareDownloadKey &key, uint seed) {
+        return ::qHash((static_cast<quint64>(key.manufacturerCode) << 48) | (static_cast<quint64>(key.imageType) << 32) | key.fileVersion, seed);
+    }
+    QHash<FirmwareDownloadKey, FetchFirmwareReply*> m_pendingFirmwareDownloads;
+    ZigbeeFirmwareVerifier m_firmwareVerifier;
     QUrl m_firmwareIndexUrl = QUrl("https://raw.githubusercontent.com/Koenkk/zigbee-OTA/master/index.json");
-    QList<FirmwareIndexEntry> m_firmwareIndex;
-    QDateTime m_lastFirmwareIndexUpdate;
+    ZigbeeFirmwareIndexService *m_firmwareIndexService = nullptr;
+    QString m_localFirmwareRepository;
 };
 
 class FetchFirmwareReply: public QObject
@@ -194,8 +284,23 @@ public:
     FetchFirmwareReply(QObject *parent): QObject(parent) {
         connect(this, &FetchFirmwareReply::finished, this, &FetchFirmwareReply::deleteLater);
     }
+
+    // Multiple things may wait for the same download. It is cancelled once none of them waits any more.
+    void addWaiter(QObject *waiter) {
+        m_waiters.insert(waiter);
+    }
+    void removeWaiter(QObject *waiter) {
+        if (m_waiters.remove(waiter) && m_waiters.isEmpty()) {
+            emit cancelRequested();
+        }
+    }
+
 signals:
     void finished();
+    void cancelRequested();
+
+private:
+    QSet<QObject*> m_waiters;
 };
 
 #endif // INTEGRATIONPLUGINZIGBEEEUROTRONIC_H
@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeenoderegistry.h"
+
+void ZigbeeNodeRegistry::insert(Thing *thing, ZigbeeNode *node, quint8 endpointId)
+{
+    if (m_nodes.contains(thing)) {
+        Entry entry = m_nodes.value(thing);
+        if (entry.node == node && entry.endpointId == endpointId) {
+            return;
+        }
+        take(thing);
+    }
+
+    Entry entry;
+    entry.node = node;
+    entry.endpointId = endpointId;
+    m_nodes.insert(thing, entry);
+    m_things[node].insert(endpointId, thing);
+}
+
+ZigbeeNode *ZigbeeNodeRegistry::take(Thing *thing)
+{
+    if (!m_nodes.contains(thing)) {
+        return nullptr;
+    }
+
+    Entry entry = m_nodes.take(thing);
+    QMultiMap<quint8, Thing *> &things = m_things[entry.node];
+    things.remove(entry.endpointId, thing);
+    if (things.isEmpty()) {
+        m_things.remove(entry.node);
+    }
+    return entry.node;
+}
+
+bool ZigbeeNodeRegistry::contains(Thing *thing) const
+{
+    return m_nodes.contains(thing);
+}
+
+bool ZigbeeNodeRegistry::contains(ZigbeeNode *node) const
+{
+    return m_things.contains(node);
+}
+
+ZigbeeNode *ZigbeeNodeRegistry::node(Thing *thing) const
+{
+    return m_nodes.value(thing).node;
+}
+
+quint8 ZigbeeNodeRegistry::endpointId(Thing *thing) const
+{
+    return m_nodes.value(thing).endpointId;
+}
+
+QList<Thing *> ZigbeeNodeRegistry::things(ZigbeeNode *node) const
+{
+    return m_things.value(node).values();
+}
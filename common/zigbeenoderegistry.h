@@ -0,0 +1,76 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEENODEREGISTRY_H
+#define ZIGBEENODEREGISTRY_H
+
+#include <QHash>
+#include <QList>
+#include <QMultiMap>
+
+class Thing;
+class ZigbeeNode;
+
+// Two way mapping between managed things and their zigbee nodes. A node may be represented by
+// multiple things, one per endpoint (or several on the same endpoint), so the node side keeps
+// its things sorted by endpoint id. All lookups are constant time, independent of the number of
+// managed things.
+class ZigbeeNodeRegistry
+{
+public:
+    ZigbeeNodeRegistry() = default;
+
+    // Things not bound to a particular endpoint are registered with endpoint id 0
+    void insert(Thing *thing, ZigbeeNode *node, quint8 endpointId = 0);
+
+    // Removes the thing and returns the node it was mapped to
+    ZigbeeNode *take(Thing *thing);
+
+    bool contains(Thing *thing) const;
+    bool contains(ZigbeeNode *node) const;
+
+    ZigbeeNode *node(Thing *thing) const;
+    quint8 endpointId(Thing *thing) const;
+
+    // All things of the node, ordered by endpoint id
+    QList<Thing *> things(ZigbeeNode *node) const;
+
+private:
+    struct Entry {
+        ZigbeeNode *node = nullptr;
+        quint8 endpointId = 0;
+    };
+
+    QHash<Thing *, Entry> m_nodes;
+    QHash<ZigbeeNode *, QMultiMap<quint8, Thing *>> m_things;
+};
+
+#endif // ZIGBEENODEREGISTRY_H
@@ -0,0 +1,114 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotablockpacer.h"
+
+#include <QtGlobal>
+
+// Blocks smaller than this add more frame overhead than they save in retries
+static const int minimumBlockSize = 16;
+// Grow the block size again after this many blocks without loss
+static const int growthThreshold = 16;
+static const int growthStep = 8;
+static const int maximumDelay = 1000;
+
+ZigbeeOtaBlockPacer::ZigbeeOtaBlockPacer()
+{
+    m_timer.start();
+}
+
+void ZigbeeOtaBlockPacer::requestReceived(quint32 offset, quint8 lqi)
+{
+    m_lqi = lqi;
+
+    if (!m_started) {
+        return;
+    }
+
+    if (offset < m_nextOffset) {
+        // The response got lost, the client asks again
+        m_failures++;
+        m_consecutiveFailures++;
+        m_consecutiveSuccesses = 0;
+        m_blockSize = qMax(minimumBlockSize, m_blockSize / 2);
+        return;
+    }
+
+    if (m_lastSent >= 0) {
+        int sample = static_cast<int>(m_timer.elapsed() - m_lastSent);
+        m_roundTripTime = m_roundTripTime < 0 ? sample : (7 * m_roundTripTime + sample) / 8;
+    }
+
+    m_consecutiveFailures = 0;
+    m_consecutiveSuccesses++;
+    if (m_consecutiveSuccesses >= growthThreshold) {
+        m_consecutiveSuccesses = 0;
+        m_blockSize = qMin(255, m_blockSize + growthStep);
+    }
+}
+
+void ZigbeeOtaBlockPacer::blockSent(quint32 offset, quint32 size)
+{
+    m_started = true;
+    m_lastSent = m_timer.elapsed();
+    m_nextOffset = qMax(m_nextOffset, offset + size);
+}
+
+quint8 ZigbeeOtaBlockPacer::blockSize(quint8 maximumDataSize) const
+{
+    int size = m_blockSize;
+    if (m_lqi < 50) {
+        size = qMin(size, 32);
+    } else if (m_lqi < 100) {
+        size = qMin(size, 48);
+    }
+    return static_cast<quint8>(qMax(1, qMin(size, static_cast<int>(maximumDataSize))));
+}
+
+int ZigbeeOtaBlockPacer::delay() const
+{
+    if (m_consecutiveFailures == 0) {
+        return 0;
+    }
+    // Give the route some time to recover, growing with every failure in a row
+    int base = m_roundTripTime > 0 ? m_roundTripTime / 2 : 100;
+    return qMin(maximumDelay, base * m_consecutiveFailures);
+}
+
+int ZigbeeOtaBlockPacer::roundTripTime() const
+{
+    return m_roundTripTime;
+}
+
+int ZigbeeOtaBlockPacer::failures() const
+{
+    return m_failures;
+}
@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTABLOCKPACER_H
+#define ZIGBEEOTABLOCKPACER_H
+
+#include <QElapsedTimer>
+
+// Adapts block size and pacing of an OTA transfer to the link. Blocks requested again indicate a lost
+// response, the block size is halved and responses are delayed for a bit. After a number of blocks
+// went through without loss the block size grows again. Poor link quality limits the block size.
+class ZigbeeOtaBlockPacer
+{
+public:
+    ZigbeeOtaBlockPacer();
+
+    // Call for every block request of the client, lqi is the link quality of the requesting node
+    void requestReceived(quint32 offset, quint8 lqi);
+    void blockSent(quint32 offset, quint32 size);
+
+    // Size of the next block, never more than the client allows
+    quint8 blockSize(quint8 maximumDataSize) const;
+    // Additional delay before sending the next block in milliseconds
+    int delay() const;
+
+    // Smoothed time between sending a block and the request for the next one, -1 if unknown
+    int roundTripTime() const;
+    int failures() const;
+
+private:
+    QElapsedTimer m_timer;
+    qint64 m_lastSent = -1;
+    quint32 m_nextOffset = 0;
+    bool m_started = false;
+
+    int m_blockSize = 255;
+    int m_roundTripTime = -1;
+    int m_failures = 0;
+    int m_consecutiveFailures = 0;
+    int m_consecutiveSuccesses = 0;
+    quint8 m_lqi = 255;
+};
+
+#endif // ZIGBEEOTABLOCKPACER_H
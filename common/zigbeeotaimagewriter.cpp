@@ -0,0 +1,177 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotaimagewriter.h"
+
+
+ZigbeeOtaImageWriter::ZigbeeOtaImageWriter(const ZigbeeFirmwareIndexEntry &info, const QString &fileName):
+    m_info(info),
+    m_file(fileName),
+    m_hash(QCryptographicHash::Sha512)
+{
+
+}
+
+bool ZigbeeOtaImageWriter::open()
+{
+    if (!m_file.open(QFile::WriteOnly)) {
+        return fail(QString("Unable to open %1 for writing: %2").arg(m_file.fileName()).arg(m_file.errorString()));
+    }
+    return true;
+}
+
+bool ZigbeeOtaImageWriter::write(const QByteArray &data)
+{
+    if (m_failed) {
+        return false;
+    }
+
+    if (m_headerFound) {
+        return writeImageData(data.constData(), static_cast<quint32>(data.size()));
+    }
+
+    m_headerBuffer.append(data);
+    return processHeader();
+}
+
+bool ZigbeeOtaImageWriter::finish()
+{
+    if (m_failed) {
+        return false;
+    }
+    if (!m_headerFound) {
+        return fail("Image identifier not found in download.");
+    }
+    if (m_bytesWritten != m_header.totalImageSize) {
+        return fail(QString("Download incomplete. Received %1 of %2 image bytes.").arg(m_bytesWritten).arg(m_header.totalImageSize));
+    }
+
+    m_sha512 = m_hash.result().toHex();
+    if (!m_info.sha512.isEmpty() && m_info.sha512 != m_sha512) {
+        return fail("SHA512 verification failed");
+    }
+
+    if (!m_file.commit()) {
+        return fail(QString("Unable to write %1: %2").arg(m_file.fileName()).arg(m_file.errorString()));
+    }
+    return true;
+}
+
+void ZigbeeOtaImageWriter::cancel()
+{
+    m_file.cancelWriting();
+    m_file.commit(); // Discards the temporary file when writing is cancelled
+}
+
+bool ZigbeeOtaImageWriter::headerFound() const
+{
+    return m_headerFound;
+}
+
+ZigbeeOtaImageHeader ZigbeeOtaImageWriter::header() const
+{
+    return m_header;
+}
+
+quint32 ZigbeeOtaImageWriter::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+QByteArray ZigbeeOtaImageWriter::sha512() const
+{
+    return m_sha512;
+}
+
+QString ZigbeeOtaImageWriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool ZigbeeOtaImageWriter::processHeader()
+{
+    ZigbeeOtaImageHeader::ParseResult result;
+    int startPos = ZigbeeOtaImageHeader::find(m_headerBuffer.constData(), m_headerBuffer.size(), &m_header, &result);
+    if (startPos < 0) {
+        // Keep the tail, the identifier might be split across two chunks
+        int keep = static_cast<int>(sizeof(ZigbeeOtaImageHeader::fileIdentifier)) - 1;
+        if (m_headerBuffer.size() > keep) {
+            m_headerBuffer.remove(0, m_headerBuffer.size() - keep);
+        }
+        return true;
+    }
+    if (startPos > 0) {
+        m_headerBuffer.remove(0, startPos);
+    }
+    if (result == ZigbeeOtaImageHeader::ParseResultIncomplete) {
+        return true;
+    }
+
+    if (m_header.totalImageSize != m_info.fileSize) {
+        return fail(QString("Image file size not matching: %1 != %2").arg(m_header.totalImageSize).arg(m_info.fileSize));
+    }
+    if (m_header.manufacturerCode != m_info.manufacturerCode) {
+        return fail(QString("Manufacturer code not matching in downloaded image: %1 != %2").arg(m_header.manufacturerCode).arg(m_info.manufacturerCode));
+    }
+    if (m_header.imageType != m_info.imageType) {
+        return fail(QString("Image type not matching in downloaded image: %1 != %2").arg(m_header.imageType).arg(m_info.imageType));
+    }
+
+    m_headerFound = true;
+    QByteArray buffered = m_headerBuffer;
+    m_headerBuffer.clear();
+    return writeImageData(buffered.constData(), static_cast<quint32>(buffered.size()));
+}
+
+bool ZigbeeOtaImageWriter::writeImageData(const char *data, quint32 length)
+{
+    // Anything behind the image (e.g. vendor signatures) is dropped
+    quint32 remaining = m_header.totalImageSize - m_bytesWritten;
+    length = qMin(length, remaining);
+    if (length == 0) {
+        return true;
+    }
+
+    if (m_file.write(data, length) != static_cast<qint64>(length)) {
+        return fail(QString("Unable to write to %1: %2").arg(m_file.fileName()).arg(m_file.errorString()));
+    }
+    m_hash.addData(data, static_cast<int>(length));
+    m_bytesWritten += length;
+    return true;
+}
+
+bool ZigbeeOtaImageWriter::fail(const QString &error)
+{
+    m_failed = true;
+    m_errorString = error;
+    m_file.cancelWriting();
+    return false;
+}
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTAIMAGEWRITER_H
+#define ZIGBEEOTAIMAGEWRITER_H
+
+#include "zigbeefirmwarecatalog.h"
+#include "zigbeeotaimageheader.h"
+
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+// Extracts the OTA image from a download while it is being received. Data in front of the OTA
+// file header (vendor containers) is dropped, the image itself is written to a temporary file
+// and hashed on the fly. Only a few bytes are buffered at any time, independent of the image size.
+// The file is moved to its final location on finish(), if the image is complete and verified.
+class ZigbeeOtaImageWriter
+{
+public:
+    ZigbeeOtaImageWriter(const ZigbeeFirmwareIndexEntry &info, const QString &fileName);
+
+    bool open();
+    bool write(const QByteArray &data);
+    bool finish();
+    void cancel();
+
+    bool headerFound() const;
+    ZigbeeOtaImageHeader header() const;
+    quint32 bytesWritten() const;
+    QByteArray sha512() const;
+    QString errorString() const;
+
+private:
+    bool processHeader();
+    bool writeImageData(const char *data, quint32 length);
+    bool fail(const QString &error);
+
+    ZigbeeFirmwareIndexEntry m_info;
+    QSaveFile m_file;
+    QCryptographicHash m_hash;
+    QByteArray m_headerBuffer;
+    ZigbeeOtaImageHeader m_header;
+    bool m_headerFound = false;
+    bool m_failed = false;
+    quint32 m_bytesWritten = 0;
+    QByteArray m_sha512;
+    QString m_errorString;
+};
+
+#endif // ZIGBEEOTAIMAGEWRITER_H
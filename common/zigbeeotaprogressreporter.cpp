@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotaprogressreporter.h"
+
+#include <QtMath>
+
+ZigbeeOtaProgressReporter::ZigbeeOtaProgressReporter(int minimumInterval):
+    m_minimumInterval(minimumInterval)
+{
+
+}
+
+int ZigbeeOtaProgressReporter::minimumInterval() const
+{
+    return m_minimumInterval;
+}
+
+void ZigbeeOtaProgressReporter::setMinimumInterval(int minimumInterval)
+{
+    m_minimumInterval = qMax(0, minimumInterval);
+}
+
+bool ZigbeeOtaProgressReporter::update(double progress)
+{
+    int percent = qBound(0, qFloor(progress), 100);
+    if (percent == m_reportedProgress) {
+        return false;
+    }
+    if (percent < 100 && m_timer.isValid() && m_timer.elapsed() < m_minimumInterval) {
+        return false;
+    }
+
+    m_reportedProgress = percent;
+    m_timer.start();
+    return true;
+}
+
+int ZigbeeOtaProgressReporter::reportedProgress() const
+{
+    return m_reportedProgress;
+}
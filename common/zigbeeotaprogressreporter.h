@@ -0,0 +1,61 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTAPROGRESSREPORTER_H
+#define ZIGBEEOTAPROGRESSREPORTER_H
+
+#include <QElapsedTimer>
+
+// Decides when the progress of an OTA transfer gets published. A transfer consists of thousands of
+// blocks, setting the progress state for each of them would flood the core and all connected clients.
+class ZigbeeOtaProgressReporter
+{
+public:
+    ZigbeeOtaProgressReporter(int minimumInterval = 1000);
+
+    // Minimum time between two reports in milliseconds
+    int minimumInterval() const;
+    void setMinimumInterval(int minimumInterval);
+
+    // Returns true if the progress should be published now. This is the case when the whole percent
+    // value changed and the last report is at least minimumInterval ago. Completion is always reported.
+    bool update(double progress);
+
+    // The last reported progress, -1 if nothing has been reported yet
+    int reportedProgress() const;
+
+private:
+    int m_minimumInterval = 1000;
+    int m_reportedProgress = -1;
+    QElapsedTimer m_timer;
+};
+
+#endif // ZIGBEEOTAPROGRESSREPORTER_H
@@ -0,0 +1,174 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotasession.h"
+
+ZigbeeOtaSession::ZigbeeOtaSession(const ZigbeeFirmwareIndexEntry &image, const QString &fileName):
+    m_image(image),
+    m_file(fileName)
+{
+
+}
+
+ZigbeeOtaSession::~ZigbeeOtaSession()
+{
+    close();
+}
+
+bool ZigbeeOtaSession::open()
+{
+    if (isOpen()) {
+        return true;
+    }
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    m_size = static_cast<quint32>(m_file.size());
+    uchar *mapped = m_file.map(0, m_size);
+    if (mapped) {
+        m_data = reinterpret_cast<const char*>(mapped);
+    } else {
+        m_buffer = m_file.readAll();
+        if (m_buffer.size() != static_cast<int>(m_size)) {
+            m_buffer.clear();
+            m_file.close();
+            return false;
+        }
+        m_data = m_buffer.constData();
+    }
+    m_telemetry = ZigbeeOtaTelemetry(m_size);
+    return true;
+}
+
+void ZigbeeOtaSession::close()
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_buffer.clear();
+    if (m_file.isOpen()) {
+        m_file.close(); // Also unmaps
+    }
+}
+
+bool ZigbeeOtaSession::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+ZigbeeFirmwareIndexEntry ZigbeeOtaSession::image() const
+{
+    return m_image;
+}
+
+bool ZigbeeOtaSession::matches(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion) const
+{
+    return m_image.manufacturerCode == manufacturerCode
+            && m_image.imageType == imageType
+            && m_image.fileVersion == fileVersion;
+}
+
+quint32 ZigbeeOtaSession::size() const
+{
+    return m_size;
+}
+
+QByteArray ZigbeeOtaSession::block(quint32 offset, quint32 maximumSize) const
+{
+    if (!isOpen() || offset >= m_size) {
+        return QByteArray();
+    }
+    quint32 length = qMin(maximumSize, m_size - offset);
+    return QByteArray::fromRawData(m_data + offset, static_cast<int>(length));
+}
+
+quint32 ZigbeeOtaSession::offset() const
+{
+    return m_offset;
+}
+
+void ZigbeeOtaSession::setOffset(quint32 offset)
+{
+    m_offset = offset;
+}
+
+quint32 ZigbeeOtaSession::storedOffset() const
+{
+    return m_storedOffset;
+}
+
+void ZigbeeOtaSession::setStoredOffset(quint32 storedOffset)
+{
+    m_storedOffset = storedOffset;
+}
+
+bool ZigbeeOtaSession::isResponsePending() const
+{
+    return m_responsePending;
+}
+
+quint32 ZigbeeOtaSession::pendingOffset() const
+{
+    return m_pendingOffset;
+}
+
+quint8 ZigbeeOtaSession::pendingTransactionSequenceNumber() const
+{
+    return m_pendingTransactionSequenceNumber;
+}
+
+void ZigbeeOtaSession::setPendingResponse(quint32 offset, quint8 transactionSequenceNumber)
+{
+    m_responsePending = true;
+    m_pendingOffset = offset;
+    m_pendingTransactionSequenceNumber = transactionSequenceNumber;
+}
+
+void ZigbeeOtaSession::clearPendingResponse()
+{
+    m_responsePending = false;
+}
+
+ZigbeeOtaTelemetry *ZigbeeOtaSession::telemetry()
+{
+    return &m_telemetry;
+}
+
+ZigbeeOtaProgressReporter *ZigbeeOtaSession::progressReporter()
+{
+    return &m_progressReporter;
+}
+
+ZigbeeOtaBlockPacer *ZigbeeOtaSession::pacer()
+{
+    return &m_pacer;
+}
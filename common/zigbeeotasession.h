@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTASESSION_H
+#define ZIGBEEOTASESSION_H
+
+#include "zigbeefirmwarecatalog.h"
+#include "zigbeeotatelemetry.h"
+#include "zigbeeotaprogressreporter.h"
+#include "zigbeeotablockpacer.h"
+
+#include <QFile>
+
+// Serves the image blocks for one running OTA transfer. The image file is opened and mapped
+// into memory once for the whole transfer, blocks are handed out as slices of that mapping.
+class ZigbeeOtaSession
+{
+public:
+    ZigbeeOtaSession(const ZigbeeFirmwareIndexEntry &image, const QString &fileName);
+    ~ZigbeeOtaSession();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    ZigbeeFirmwareIndexEntry image() const;
+    bool matches(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion) const;
+
+    quint32 size() const;
+
+    // Note: The returned data does not own the memory. It is only valid as long as the session is open.
+    QByteArray block(quint32 offset, quint32 maximumSize) const;
+
+    // The offset of the last block requested by the client. Everything before it has been received.
+    quint32 offset() const;
+    void setOffset(quint32 offset);
+
+    // The offset last written to persistent storage, used to resume the transfer after a restart
+    quint32 storedOffset() const;
+    void setStoredOffset(quint32 storedOffset);
+
+    // Block responses are paced by delaying them, there is at most one waiting per session.
+    // A client repeating the request for it only updates the transaction sequence number.
+    bool isResponsePending() const;
+    quint32 pendingOffset() const;
+    quint8 pendingTransactionSequenceNumber() const;
+    void setPendingResponse(quint32 offset, quint8 transactionSequenceNumber);
+    void clearPendingResponse();
+
+    ZigbeeOtaTelemetry *telemetry();
+    ZigbeeOtaProgressReporter *progressReporter();
+    ZigbeeOtaBlockPacer *pacer();
+
+private:
+    ZigbeeFirmwareIndexEntry m_image;
+    QFile m_file;
+    const char *m_data = nullptr;
+    quint32 m_size = 0;
+    quint32 m_offset = 0;
+    quint32 m_storedOffset = 0;
+    bool m_responsePending = false;
+    quint32 m_pendingOffset = 0;
+    quint8 m_pendingTransactionSequenceNumber = 0;
+    ZigbeeOtaTelemetry m_telemetry;
+    ZigbeeOtaProgressReporter m_progressReporter;
+    ZigbeeOtaBlockPacer m_pacer;
+    QByteArray m_buffer; // Fallback if the file can't be mapped
+};
+
+#endif // ZIGBEEOTASESSION_H
@@ -0,0 +1,205 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotatelemetry.h"
+
+// Only the most recent retransmitted offsets are kept for the dump
+static const int maximumRetransmittedOffsets = 100;
+
+static const QList<int> buckets = {50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+ZigbeeOtaTelemetry::ZigbeeOtaTelemetry(quint32 imageSize):
+    m_imageSize(imageSize)
+{
+    for (int i = 0; i <= buckets.count(); i++) {
+        m_latencyHistogram.append(0);
+    }
+}
+
+void ZigbeeOtaTelemetry::requestReceived(quint32 offset)
+{
+    if (!m_timer.isValid()) {
+        m_timer.start();
+        m_startTime = QDateTime::currentDateTime();
+    }
+
+    qint64 now = m_timer.elapsed();
+    // Time the client took to come back after the previous block, this is where bad routes show up
+    if (m_lastBlockTime >= 0 && m_requestTime < 0) {
+        qint64 turnaround = now - m_lastBlockTime;
+        m_minimumTurnaround = m_minimumTurnaround < 0 ? turnaround : qMin(m_minimumTurnaround, turnaround);
+        m_maximumTurnaround = qMax(m_maximumTurnaround, turnaround);
+        m_totalTurnaround += turnaround;
+        m_turnaroundSamples++;
+    }
+
+    // A repeated request for a block still being waited for doesn't restart the measurement
+    if (m_requestTime < 0 || offset != m_requestOffset) {
+        m_requestTime = now;
+        m_requestOffset = offset;
+    }
+}
+
+void ZigbeeOtaTelemetry::recordBlock(quint32 offset, quint32 size)
+{
+    if (!m_timer.isValid()) {
+        m_timer.start();
+        m_startTime = QDateTime::currentDateTime();
+    }
+    if (m_blocks == 0) {
+        m_startOffset = offset;
+        m_endOffset = offset;
+    }
+
+    qint64 now = m_timer.elapsed();
+    if (m_requestTime >= 0 && offset == m_requestOffset) {
+        qint64 latency = now - m_requestTime;
+        int bucket = 0;
+        while (bucket < buckets.count() && latency > buckets.at(bucket)) {
+            bucket++;
+        }
+        m_latencyHistogram[bucket]++;
+        m_minimumLatency = m_minimumLatency < 0 ? latency : qMin(m_minimumLatency, latency);
+        m_maximumLatency = qMax(m_maximumLatency, latency);
+        m_totalLatency += latency;
+        m_latencySamples++;
+    }
+    m_requestTime = -1;
+    m_lastBlockTime = now;
+    m_blocks++;
+
+    // A block before the end of the data sent so far has been lost on the way and is requested again
+    if (offset < m_endOffset) {
+        m_retransmissions++;
+        m_retransmittedOffsets.append(offset);
+        if (m_retransmittedOffsets.count() > maximumRetransmittedOffsets) {
+            m_retransmittedOffsets.removeFirst();
+        }
+    }
+    m_endOffset = qMax(m_endOffset, offset + size);
+    m_bytesTransferred += size;
+}
+
+quint32 ZigbeeOtaTelemetry::imageSize() const
+{
+    return m_imageSize;
+}
+
+quint32 ZigbeeOtaTelemetry::bytesTransferred() const
+{
+    return m_bytesTransferred;
+}
+
+int ZigbeeOtaTelemetry::blocks() const
+{
+    return m_blocks;
+}
+
+int ZigbeeOtaTelemetry::retransmissions() const
+{
+    return m_retransmissions;
+}
+
+QList<quint32> ZigbeeOtaTelemetry::retransmittedOffsets() const
+{
+    return m_retransmittedOffsets;
+}
+
+double ZigbeeOtaTelemetry::bytesPerSecond() const
+{
+    if (!m_timer.isValid() || m_lastBlockTime <= 0) {
+        return 0;
+    }
+    // Only count progress, retransmitted data doesn't bring the transfer forward
+    return 1000.0 * (m_endOffset - m_startOffset) / m_lastBlockTime;
+}
+
+int ZigbeeOtaTelemetry::secondsRemaining() const
+{
+    double rate = bytesPerSecond();
+    if (rate <= 0 || m_imageSize == 0) {
+        return -1;
+    }
+    quint32 remaining = m_imageSize > m_endOffset ? m_imageSize - m_endOffset : 0;
+    return qRound(remaining / rate);
+}
+
+QList<int> ZigbeeOtaTelemetry::latencyBuckets()
+{
+    return buckets;
+}
+
+QList<int> ZigbeeOtaTelemetry::latencyHistogram() const
+{
+    return m_latencyHistogram;
+}
+
+QVariantMap ZigbeeOtaTelemetry::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("startTime", m_startTime.toString(Qt::ISODate));
+    map.insert("duration", m_timer.isValid() ? m_lastBlockTime / 1000.0 : 0);
+    map.insert("imageSize", m_imageSize);
+    map.insert("startOffset", m_startOffset);
+    map.insert("offset", m_endOffset);
+    map.insert("bytesTransferred", m_bytesTransferred);
+    map.insert("bytesPerSecond", bytesPerSecond());
+    map.insert("secondsRemaining", secondsRemaining());
+    map.insert("blocks", m_blocks);
+    map.insert("retransmissions", m_retransmissions);
+
+    QVariantList offsets;
+    foreach (quint32 offset, m_retransmittedOffsets) {
+        offsets.append(offset);
+    }
+    map.insert("retransmittedOffsets", offsets);
+
+    QVariantMap latency;
+    latency.insert("minimum", m_minimumLatency);
+    latency.insert("maximum", m_maximumLatency);
+    latency.insert("average", m_latencySamples > 0 ? static_cast<double>(m_totalLatency) / m_latencySamples : -1);
+    QVariantList histogram;
+    for (int i = 0; i < m_latencyHistogram.count(); i++) {
+        QVariantMap bucket;
+        bucket.insert("upTo", i < buckets.count() ? QVariant(buckets.at(i)) : QVariant());
+        bucket.insert("count", m_latencyHistogram.at(i));
+        histogram.append(bucket);
+    }
+    latency.insert("histogram", histogram);
+    map.insert("latency", latency);
+
+    QVariantMap turnaround;
+    turnaround.insert("minimum", m_minimumTurnaround);
+    turnaround.insert("maximum", m_maximumTurnaround);
+    turnaround.insert("average", m_turnaroundSamples > 0 ? static_cast<double>(m_totalTurnaround) / m_turnaroundSamples : -1);
+    map.insert("turnaround", turnaround);
+    return map;
+}
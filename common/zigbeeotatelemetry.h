@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTATELEMETRY_H
+#define ZIGBEEOTATELEMETRY_H
+
+#include <QList>
+#include <QVariantMap>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+// Collects statistics about a running OTA transfer: throughput, block latency, retransmitted blocks
+// and the estimated time remaining. The latency is measured from a block request to the response
+// and thus contains the pacing delay, the turnaround from a response to the next request doesn't.
+class ZigbeeOtaTelemetry
+{
+public:
+    ZigbeeOtaTelemetry(quint32 imageSize = 0);
+
+    // Call for every image block request received from the client
+    void requestReceived(quint32 offset);
+    // Call for every image block sent to the client
+    void recordBlock(quint32 offset, quint32 size);
+
+    quint32 imageSize() const;
+    quint32 bytesTransferred() const;
+    int blocks() const;
+    int retransmissions() const;
+    QList<quint32> retransmittedOffsets() const;
+
+    // Average since the first block of this session, bytes per second
+    double bytesPerSecond() const;
+    // -1 if not known yet
+    int secondsRemaining() const;
+
+    // Upper bounds of the latency histogram buckets in milliseconds, the last bucket has no upper bound
+    static QList<int> latencyBuckets();
+    QList<int> latencyHistogram() const;
+
+    QVariantMap toVariantMap() const;
+
+private:
+    quint32 m_imageSize = 0;
+    QDateTime m_startTime;
+    QElapsedTimer m_timer;
+    qint64 m_lastBlockTime = -1;
+    qint64 m_requestTime = -1;
+    quint32 m_requestOffset = 0;
+
+    quint32 m_startOffset = 0;
+    quint32 m_endOffset = 0;
+    quint32 m_bytesTransferred = 0;
+    int m_blocks = 0;
+    int m_retransmissions = 0;
+    QList<quint32> m_retransmittedOffsets;
+
+    QList<int> m_latencyHistogram;
+    int m_latencySamples = 0;
+    qint64 m_minimumLatency = -1;
+    qint64 m_maximumLatency = -1;
+    qint64 m_totalLatency = 0;
+
+    int m_turnaroundSamples = 0;
+    qint64 m_minimumTurnaround = -1;
+    qint64 m_maximumTurnaround = -1;
+    qint64 m_totalTurnaround = 0;
+};
+
+#endif // ZIGBEEOTATELEMETRY_H
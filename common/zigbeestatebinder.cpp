@@ -0,0 +1,224 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeestatebinder.h"
+
+#include <zigbeenodeendpoint.h>
+#include <zcl/zigbeecluster.h>
+
+#include <QtMath>
+
+ZigbeeStateBinding::ZigbeeStateBinding(ZigbeeClusterLibrary::ClusterId clusterId, quint16 attributeId, Converter converter, const StateTypeId &stateTypeId, double scale, double hysteresis, Target target):
+    clusterId(clusterId),
+    attributeId(attributeId),
+    converter(converter),
+    stateTypeId(stateTypeId),
+    scale(scale),
+    hysteresis(hysteresis),
+    target(target)
+{
+
+}
+
+ZigbeeStateBinder::ZigbeeStateBinder(const QLoggingCategory &loggingCategory, QObject *parent):
+    QObject(parent),
+    m_dc(loggingCategory.categoryName())
+{
+
+}
+
+bool ZigbeeStateBinder::bind(Thing *thing, ZigbeeNodeEndpoint *endpoint, const QList<ZigbeeStateBinding> &bindings)
+{
+    bool complete = true;
+    foreach (const ZigbeeStateBinding &binding, bindings) {
+        ZigbeeCluster *cluster = endpoint->getInputCluster(binding.clusterId);
+        if (!cluster) {
+            qCWarning(m_dc) << "Cannot bind state of" << thing->name() << "to cluster" << binding.clusterId << "which is missing on endpoint" << endpoint->endpointId();
+            complete = false;
+            continue;
+        }
+        if (binding.stateTypeId.isNull() || !thing->hasState(binding.stateTypeId)) {
+            continue;
+        }
+
+        if (!m_entries.contains(cluster)) {
+            connect(cluster, &ZigbeeCluster::attributeChanged, this, &ZigbeeStateBinder::onAttributeChanged);
+            connect(cluster, &ZigbeeCluster::destroyed, this, &ZigbeeStateBinder::onClusterDestroyed);
+        }
+
+        // Setting up a thing again replaces its previous bindings
+        QVector<Entry> &entries = m_entries[cluster];
+        for (int i = entries.count() - 1; i >= 0; i--) {
+            const Entry &existing = entries.at(i);
+            if (existing.thing == thing && existing.binding.attributeId == binding.attributeId
+                    && existing.binding.stateTypeId == binding.stateTypeId && existing.binding.target == binding.target) {
+                entries.remove(i);
+            }
+        }
+
+        if (!m_things.contains(thing)) {
+            m_things.insert(thing, thing);
+            connect(thing, &Thing::destroyed, this, &ZigbeeStateBinder::onThingDestroyed);
+        }
+
+        Entry entry;
+        entry.thing = thing;
+        entry.binding = binding;
+        entries.append(entry);
+
+        if (cluster->hasAttribute(binding.attributeId)) {
+            apply(entry, cluster->attribute(binding.attributeId).dataType());
+        }
+    }
+    return complete;
+}
+
+void ZigbeeStateBinder::unbind(Thing *thing)
+{
+    if (m_things.remove(thing) > 0) {
+        disconnect(thing, &Thing::destroyed, this, &ZigbeeStateBinder::onThingDestroyed);
+    }
+    removeEntries(thing);
+}
+
+void ZigbeeStateBinder::removeEntries(Thing *thing)
+{
+    QMutableHashIterator<ZigbeeCluster *, QVector<Entry>> it(m_entries);
+    while (it.hasNext()) {
+        it.next();
+        QVector<Entry> &entries = it.value();
+        for (int i = entries.count() - 1; i >= 0; i--) {
+            if (entries.at(i).thing == thing) {
+                entries.remove(i);
+            }
+        }
+        if (entries.isEmpty()) {
+            disconnect(it.key(), nullptr, this, nullptr);
+            it.remove();
+        }
+    }
+}
+
+QVariant ZigbeeStateBinder::toBool(const ZigbeeDataType &dataType)
+{
+    return dataType.toBool();
+}
+
+QVariant ZigbeeStateBinder::toUInt8(const ZigbeeDataType &dataType)
+{
+    return dataType.toUInt8();
+}
+
+QVariant ZigbeeStateBinder::toUInt16(const ZigbeeDataType &dataType)
+{
+    return dataType.toUInt16();
+}
+
+QVariant ZigbeeStateBinder::toInt16(const ZigbeeDataType &dataType)
+{
+    return dataType.toInt16();
+}
+
+QVariant ZigbeeStateBinder::toNonZero(const ZigbeeDataType &dataType)
+{
+    return dataType.toUInt8() > 0;
+}
+
+QVariant ZigbeeStateBinder::toLevelPercentage(const ZigbeeDataType &dataType)
+{
+    return dataType.toUInt8() * 100 / 255;
+}
+
+QVariant ZigbeeStateBinder::toIlluminance(const ZigbeeDataType &dataType)
+{
+    return qPow(10, (dataType.toUInt16() - 1) / 10000.0);
+}
+
+void ZigbeeStateBinder::onAttributeChanged(const ZigbeeClusterAttribute &attribute)
+{
+    ZigbeeCluster *cluster = static_cast<ZigbeeCluster *>(sender());
+    QHash<ZigbeeCluster *, QVector<Entry>>::const_iterator it = m_entries.constFind(cluster);
+    if (it == m_entries.constEnd()) {
+        return;
+    }
+
+    // Copy, applying a state may end up in unbind()
+    const QVector<Entry> entries = it.value();
+    foreach (const Entry &entry, entries) {
+        if (entry.binding.attributeId == attribute.id()) {
+            apply(entry, attribute.dataType());
+        }
+    }
+}
+
+void ZigbeeStateBinder::onClusterDestroyed(QObject *cluster)
+{
+    m_entries.remove(static_cast<ZigbeeCluster *>(cluster));
+}
+
+void ZigbeeStateBinder::onThingDestroyed(QObject *object)
+{
+    // The Thing part has been destroyed already, the pointer is only compared
+    Thing *thing = m_things.take(object);
+    if (thing) {
+        removeEntries(thing);
+    }
+}
+
+void ZigbeeStateBinder::apply(const Entry &entry, const ZigbeeDataType &dataType)
+{
+    const ZigbeeStateBinding &binding = entry.binding;
+    QVariant value = binding.converter(dataType);
+    if (binding.scale != 1) {
+        value = value.toDouble() * binding.scale;
+    }
+
+    switch (binding.target) {
+    case ZigbeeStateBinding::TargetValue: {
+        QVariant currentValue = entry.thing->stateValue(binding.stateTypeId);
+        if (currentValue == value) {
+            return;
+        }
+        // Scaled values are not exact, a step of exactly the hysteresis must not be dropped because of rounding errors
+        if (binding.hysteresis > 0 && currentValue.isValid() && qAbs(currentValue.toDouble() - value.toDouble()) < binding.hysteresis - 1e-9) {
+            return;
+        }
+        entry.thing->setStateValue(binding.stateTypeId, value);
+        break;
+    }
+    case ZigbeeStateBinding::TargetMinValue:
+        entry.thing->setStateMinValue(binding.stateTypeId, value);
+        break;
+    case ZigbeeStateBinding::TargetMaxValue:
+        entry.thing->setStateMaxValue(binding.stateTypeId, value);
+        break;
+    }
+}
@@ -0,0 +1,122 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEESTATEBINDER_H
+#define ZIGBEESTATEBINDER_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QLoggingCategory>
+
+#include "integrations/thing.h"
+
+#include <zcl/zigbeeclusterlibrary.h>
+#include <zcl/zigbeeclusterattribute.h>
+
+class ZigbeeCluster;
+class ZigbeeNodeEndpoint;
+
+// Maps a cluster attribute to a thing state. The converter turns the raw attribute data into the
+// state value, which is multiplied by scale if that is not 1. Numeric updates which differ by less
+// than hysteresis from the current state value are dropped.
+struct ZigbeeStateBinding
+{
+    enum Target {
+        TargetValue,
+        TargetMinValue,
+        TargetMaxValue
+    };
+
+    typedef QVariant (*Converter)(const ZigbeeDataType &dataType);
+
+    ZigbeeStateBinding() = default;
+    ZigbeeStateBinding(ZigbeeClusterLibrary::ClusterId clusterId, quint16 attributeId, Converter converter, const StateTypeId &stateTypeId,
+                       double scale = 1, double hysteresis = 0, Target target = TargetValue);
+
+    ZigbeeClusterLibrary::ClusterId clusterId = ZigbeeClusterLibrary::ClusterIdUnknown;
+    quint16 attributeId = 0;
+    Converter converter = nullptr;
+    StateTypeId stateTypeId;
+    double scale = 1;
+    double hysteresis = 0;
+    Target target = TargetValue;
+};
+
+// Applies attribute changes to thing states for all bindings of a plugin. There is one connection
+// per cluster, no matter how many bindings or things use it, and a single dispatcher looks up the
+// bindings of the reporting cluster.
+class ZigbeeStateBinder: public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ZigbeeStateBinder(const QLoggingCategory &loggingCategory, QObject *parent = nullptr);
+
+    // Binds the input clusters of the endpoint and applies attribute values which are known already.
+    // Bindings for clusters the endpoint doesn't have, or states the thing doesn't have, are skipped.
+    // Returns false if a cluster is missing.
+    bool bind(Thing *thing, ZigbeeNodeEndpoint *endpoint, const QList<ZigbeeStateBinding> &bindings);
+    // Things which are destroyed without being unbound are unbound automatically
+    void unbind(Thing *thing);
+
+    // Converters
+    static QVariant toBool(const ZigbeeDataType &dataType);
+    static QVariant toUInt8(const ZigbeeDataType &dataType);
+    static QVariant toUInt16(const ZigbeeDataType &dataType);
+    static QVariant toInt16(const ZigbeeDataType &dataType);
+    static QVariant toNonZero(const ZigbeeDataType &dataType);
+    // 0 - 254 level to 0 - 100 %
+    static QVariant toLevelPercentage(const ZigbeeDataType &dataType);
+    // 10000 * log10(lux) + 1 to lux
+    static QVariant toIlluminance(const ZigbeeDataType &dataType);
+
+private slots:
+    void onAttributeChanged(const ZigbeeClusterAttribute &attribute);
+    void onClusterDestroyed(QObject *cluster);
+    void onThingDestroyed(QObject *thing);
+
+private:
+    struct Entry {
+        Thing *thing = nullptr;
+        ZigbeeStateBinding binding;
+    };
+
+    void removeEntries(Thing *thing);
+    void apply(const Entry &entry, const ZigbeeDataType &dataType);
+
+    QLoggingCategory m_dc;
+    QHash<ZigbeeCluster *, QVector<Entry>> m_entries;
+    // Bound things by their QObject address, which is all that is left once destroyed() is emitted
+    QHash<QObject *, Thing *> m_things;
+};
+
+#endif // ZIGBEESTATEBINDER_H
@@ -0,0 +1,129 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeethingclassids.h"
+
+static const char *const paramNames[] = {
+    "networkUuid",
+    "ieeeAddress",
+    "endpointId"
+};
+Q_STATIC_ASSERT(sizeof(paramNames) / sizeof(paramNames[0]) == ZigbeeThingClassIds::ParamCount);
+
+static const char *const stateNames[] = {
+    "connected",
+    "signalStrength",
+    "batteryLevel",
+    "batteryCritical",
+    "targetTemperature",
+    "temperature",
+    "heatingOn",
+    "coolingOn",
+    "humidity",
+    "power",
+    "brightness",
+    "color",
+    "colorTemperature",
+    "flowRate",
+    "currentPower",
+    "totalEnergyConsumed",
+    "tampered",
+    "lightIntensity",
+    "isPresent",
+    "lastSeenTime",
+    "currentVersion",
+    "availableVersion",
+    "updateStatus",
+    "updateProgress",
+    "updateTransferRate",
+    "updateTimeRemaining",
+    "updateRetransmissions"
+};
+Q_STATIC_ASSERT(sizeof(stateNames) / sizeof(stateNames[0]) == ZigbeeThingClassIds::StateCount);
+
+static const char *const actionNames[] = {
+    "power",
+    "brightness",
+    "color",
+    "colorTemperature",
+    "flowRate"
+};
+Q_STATIC_ASSERT(sizeof(actionNames) / sizeof(actionNames[0]) == ZigbeeThingClassIds::ActionCount);
+
+void ZigbeeThingClassIds::build(const ThingClasses &thingClasses)
+{
+    m_tables.clear();
+    foreach (const ThingClass &thingClass, thingClasses) {
+        Table &table = m_tables[thingClass.id()];
+        for (int i = 0; i < ParamCount; i++) {
+            table.paramTypeIds[i] = thingClass.paramTypes().findByName(paramNames[i]).id();
+        }
+        for (int i = 0; i < StateCount; i++) {
+            table.stateTypes[i] = thingClass.stateTypes().findByName(stateNames[i]);
+        }
+        for (int i = 0; i < ActionCount; i++) {
+            table.actionTypeIds[i] = thingClass.actionTypes().findByName(actionNames[i]).id();
+        }
+    }
+}
+
+ParamTypeId ZigbeeThingClassIds::paramTypeId(const ThingClassId &thingClassId, Param param) const
+{
+    const Table *t = table(thingClassId);
+    return t ? t->paramTypeIds[param] : ParamTypeId();
+}
+
+StateTypeId ZigbeeThingClassIds::stateTypeId(const ThingClassId &thingClassId, State state) const
+{
+    const Table *t = table(thingClassId);
+    return t ? t->stateTypes[state].id() : StateTypeId();
+}
+
+ActionTypeId ZigbeeThingClassIds::actionTypeId(const ThingClassId &thingClassId, Action action) const
+{
+    const Table *t = table(thingClassId);
+    return t ? t->actionTypeIds[action] : ActionTypeId();
+}
+
+StateType ZigbeeThingClassIds::stateType(const ThingClassId &thingClassId, State state) const
+{
+    const Table *t = table(thingClassId);
+    return t ? t->stateTypes[state] : StateType(StateTypeId());
+}
+
+const ZigbeeThingClassIds::Table *ZigbeeThingClassIds::table(const ThingClassId &thingClassId) const
+{
+    QHash<ThingClassId, Table>::const_iterator it = m_tables.constFind(thingClassId);
+    if (it == m_tables.constEnd()) {
+        return nullptr;
+    }
+    return &it.value();
+}
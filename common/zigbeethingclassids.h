@@ -0,0 +1,115 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEETHINGCLASSIDS_H
+#define ZIGBEETHINGCLASSIDS_H
+
+#include "integrations/thing.h"
+
+#include <QHash>
+
+// Type ids of the params, states and actions the common zigbee helpers work with, resolved once per
+// thing class. Looking them up by name would scan the type lists of the thing class for every
+// attribute report. Names a thing class does not have resolve to null ids.
+class ZigbeeThingClassIds
+{
+public:
+    enum Param {
+        ParamNetworkUuid,
+        ParamIeeeAddress,
+        ParamEndpointId,
+        ParamCount
+    };
+
+    enum State {
+        StateConnected,
+        StateSignalStrength,
+        StateBatteryLevel,
+        StateBatteryCritical,
+        StateTargetTemperature,
+        StateTemperature,
+        StateHeatingOn,
+        StateCoolingOn,
+        StateHumidity,
+        StatePower,
+        StateBrightness,
+        StateColor,
+        StateColorTemperature,
+        StateFlowRate,
+        StateCurrentPower,
+        StateTotalEnergyConsumed,
+        StateTampered,
+        StateLightIntensity,
+        StateIsPresent,
+        StateLastSeenTime,
+        StateCurrentVersion,
+        StateAvailableVersion,
+        StateUpdateStatus,
+        StateUpdateProgress,
+        StateUpdateTransferRate,
+        StateUpdateTimeRemaining,
+        StateUpdateRetransmissions,
+        StateCount
+    };
+
+    enum Action {
+        ActionPower,
+        ActionBrightness,
+        ActionColor,
+        ActionColorTemperature,
+        ActionFlowRate,
+        ActionCount
+    };
+
+    ZigbeeThingClassIds() = default;
+
+    void build(const ThingClasses &thingClasses);
+
+    ParamTypeId paramTypeId(const ThingClassId &thingClassId, Param param) const;
+    StateTypeId stateTypeId(const ThingClassId &thingClassId, State state) const;
+    ActionTypeId actionTypeId(const ThingClassId &thingClassId, Action action) const;
+
+    // The full state type, for limits like minValue() and maxValue()
+    StateType stateType(const ThingClassId &thingClassId, State state) const;
+
+private:
+    struct Table {
+        ParamTypeId paramTypeIds[ParamCount];
+        StateType stateTypes[StateCount];
+        ActionTypeId actionTypeIds[ActionCount];
+    };
+
+    const Table *table(const ThingClassId &thingClassId) const;
+
+    QHash<ThingClassId, Table> m_tables;
+};
+
+#endif // ZIGBEETHINGCLASSIDS_H
@@ -0,0 +1,37 @@
+# Firmware index, cache and OTA scheduling shared by all zigbee plugins. This has to be a real
+# shared library, the plugins are loaded separately and would otherwise each get their own copy.
+TEMPLATE = lib
+TARGET = nymea-plugins-zigbee-firmware
+VERSION = 1.0.0
+
+QT -= gui
+QT += network
+
+CONFIG += c++11
+
+target.path = $$[QT_INSTALL_LIBS]
+INSTALLS += target
+
+SOURCES += \
+    zigbeefirmwarelogging.cpp \
+    zigbeefirmwarecatalog.cpp \
+    zigbeefirmwarecachemanager.cpp \
+    zigbeefirmwareindexservice.cpp \
+    zigbeefirmwareindexcache.cpp \
+    zigbeefirmwareindexreader.cpp \
+    zigbeefirmwarerepository.cpp \
+    zigbeeotaimageheader.cpp \
+    zigbeeotascheduler.cpp \
+
+HEADERS += \
+    zigbeefirmwarelogging.h \
+    zigbeefirmwarecatalog.h \
+    zigbeefirmwarecachemanager.h \
+    zigbeefirmwareindexservice.h \
+    zigbeefirmwareindexcache.h \
+    zigbeefirmwareindexreader.h \
+    zigbeefirmwarerepository.h \
+    zigbeeotaimageheader.h \
+    zigbeeotascheduler.h \
+    zigbeesharedregistry.h \
+
@@ -0,0 +1,287 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwarecachemanager.h"
+
+#include "zigbeefirmwarelogging.h"
+#include "zigbeesharedregistry.h"
+
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QSettings>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+
+#include <algorithm>
+
+// Recently written files are never removed. This covers images which are still being downloaded.
+static const qint64 gracePeriod = 60 * 60 * 1000;
+
+// Usage changes are collected for this long before being written, in milliseconds
+static const int storeUsageDelay = 10 * 1000;
+
+static ZigbeeSharedRegistry<ZigbeeFirmwareCacheManager> &managers()
+{
+    static ZigbeeSharedRegistry<ZigbeeFirmwareCacheManager> managers;
+    return managers;
+}
+
+ZigbeeFirmwareCacheManager *ZigbeeFirmwareCacheManager::acquire(QObject *subscriber)
+{
+    return managers().acquire(subscriber, [](){
+        return new ZigbeeFirmwareCacheManager();
+    });
+}
+
+void ZigbeeFirmwareCacheManager::release(QObject *subscriber)
+{
+    m_indexedImages.remove(subscriber);
+    m_pinnedImages.remove(subscriber);
+    managers().release(this, subscriber);
+}
+
+QString ZigbeeFirmwareCacheManager::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/zigbee-firmwares";
+}
+
+ZigbeeFirmwareCacheManager::ZigbeeFirmwareCacheManager(QObject *parent):
+    QObject(parent)
+{
+    // Cleanup runs deferred so multiple changes result in a single run
+    m_cleanupTimer.setSingleShot(true);
+    m_cleanupTimer.setInterval(0);
+    connect(&m_cleanupTimer, &QTimer::timeout, this, &ZigbeeFirmwareCacheManager::cleanup);
+
+    m_usageTimer.setSingleShot(true);
+    m_usageTimer.setInterval(storeUsageDelay);
+    connect(&m_usageTimer, &QTimer::timeout, this, &ZigbeeFirmwareCacheManager::storeUsage);
+
+    loadUsage();
+}
+
+ZigbeeFirmwareCacheManager::~ZigbeeFirmwareCacheManager()
+{
+    managers().remove(this);
+    if (m_usageTimer.isActive()) {
+        storeUsage();
+    }
+}
+
+qint64 ZigbeeFirmwareCacheManager::budget() const
+{
+    return m_budget;
+}
+
+void ZigbeeFirmwareCacheManager::setBudget(qint64 budget)
+{
+    m_budget = budget;
+    scheduleCleanup();
+}
+
+void ZigbeeFirmwareCacheManager::setIndexedImages(QObject *subscriber, const QSet<QString> &fileNames)
+{
+    QSet<QString> cleanFileNames;
+    foreach (const QString &fileName, fileNames) {
+        cleanFileNames.insert(QDir::cleanPath(fileName));
+    }
+    m_indexedImages[subscriber] = cleanFileNames;
+    scheduleCleanup();
+}
+
+void ZigbeeFirmwareCacheManager::setPinnedImages(QObject *subscriber, const QSet<QString> &fileNames)
+{
+    QSet<QString> cleanFileNames;
+    foreach (const QString &fileName, fileNames) {
+        cleanFileNames.insert(QDir::cleanPath(fileName));
+    }
+    if (m_pinnedImages.value(subscriber) == cleanFileNames) {
+        return;
+    }
+    m_pinnedImages[subscriber] = cleanFileNames;
+    scheduleCleanup();
+}
+
+void ZigbeeFirmwareCacheManager::touch(const QString &fileName)
+{
+    m_lastUsed.insert(QDir::cleanPath(fileName), QDateTime::currentMSecsSinceEpoch());
+    scheduleStoreUsage();
+    scheduleCleanup();
+}
+
+qint64 ZigbeeFirmwareCacheManager::cacheSize() const
+{
+    qint64 size = 0;
+    foreach (const CachedImage &image, cachedImages()) {
+        size += image.size;
+    }
+    return size;
+}
+
+void ZigbeeFirmwareCacheManager::cleanup()
+{
+    QSet<QString> pinned;
+    foreach (const QSet<QString> &fileNames, m_pinnedImages) {
+        pinned.unite(fileNames);
+    }
+
+    // Only prune superseded images if all plugins know their index, otherwise we'd remove images of the others
+    QSet<QObject*> subscribers = managers().subscribers();
+    bool pruneSuperseded = !subscribers.isEmpty();
+    QSet<QString> indexed;
+    foreach (QObject *subscriber, subscribers) {
+        if (!m_indexedImages.contains(subscriber)) {
+            pruneSuperseded = false;
+            break;
+        }
+        indexed.unite(m_indexedImages.value(subscriber));
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 cacheSize = 0;
+    QList<CachedImage> candidates;
+    QSet<QString> existing;
+    foreach (const CachedImage &image, cachedImages()) {
+        existing.insert(image.fileName);
+        cacheSize += image.size;
+        if (pinned.contains(image.fileName) || now - image.lastModified < gracePeriod) {
+            continue;
+        }
+        if (pruneSuperseded && !indexed.contains(image.fileName)) {
+            qCDebug(dcZigbeeFirmware()) << "Removing superseded firmware image" << image.fileName;
+            if (removeImage(image)) {
+                cacheSize -= image.size;
+            }
+            continue;
+        }
+        candidates.append(image);
+    }
+
+    if (cacheSize > m_budget) {
+        std::sort(candidates.begin(), candidates.end(), [](const CachedImage &a, const CachedImage &b){
+            return a.lastUsed < b.lastUsed;
+        });
+        foreach (const CachedImage &image, candidates) {
+            if (cacheSize <= m_budget) {
+                break;
+            }
+            qCDebug(dcZigbeeFirmware()) << "Firmware cache exceeds budget. Evicting least recently used image" << image.fileName;
+            if (removeImage(image)) {
+                cacheSize -= image.size;
+            }
+        }
+    }
+
+    if (cacheSize > m_budget) {
+        qCWarning(dcZigbeeFirmware()) << "Firmware cache size" << cacheSize << "exceeds the budget of" << m_budget << "bytes but all images are in use";
+    }
+
+    // Forget about images removed by someone else
+    foreach (const QString &fileName, m_lastUsed.keys()) {
+        if (!existing.contains(fileName)) {
+            m_lastUsed.remove(fileName);
+        }
+    }
+
+    scheduleStoreUsage();
+}
+
+QList<ZigbeeFirmwareCacheManager::CachedImage> ZigbeeFirmwareCacheManager::cachedImages() const
+{
+    // Images are stored as <manufacturerCode>/<imageType>/<file>. Anything else, like the cached indexes, is not ours.
+    QList<CachedImage> images;
+    QDir cacheDir(cacheDirectory());
+    foreach (const QFileInfo &manufacturerDir, cacheDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool isNumber = false;
+        manufacturerDir.fileName().toUInt(&isNumber);
+        if (!isNumber) {
+            continue;
+        }
+        foreach (const QFileInfo &imageTypeDir, QDir(manufacturerDir.absoluteFilePath()).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            imageTypeDir.fileName().toUInt(&isNumber);
+            if (!isNumber) {
+                continue;
+            }
+            foreach (const QFileInfo &fileInfo, QDir(imageTypeDir.absoluteFilePath()).entryInfoList(QDir::Files | QDir::Hidden)) {
+                CachedImage image;
+                image.fileName = QDir::cleanPath(fileInfo.absoluteFilePath());
+                image.size = fileInfo.size();
+                image.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+                image.lastUsed = m_lastUsed.value(image.fileName, image.lastModified);
+                images.append(image);
+            }
+        }
+    }
+    return images;
+}
+
+bool ZigbeeFirmwareCacheManager::removeImage(const CachedImage &image)
+{
+    m_lastUsed.remove(image.fileName);
+    if (!QFile::remove(image.fileName)) {
+        qCWarning(dcZigbeeFirmware()) << "Unable to remove cached firmware image" << image.fileName;
+        return false;
+    }
+    return true;
+}
+
+void ZigbeeFirmwareCacheManager::loadUsage()
+{
+    QSettings usage(cacheDirectory() + "/usage.ini", QSettings::IniFormat);
+    foreach (const QString &key, usage.allKeys()) {
+        m_lastUsed.insert(QDir::cleanPath(cacheDirectory() + "/" + key), usage.value(key).toLongLong());
+    }
+}
+
+void ZigbeeFirmwareCacheManager::storeUsage()
+{
+    m_usageTimer.stop();
+    QSettings usage(cacheDirectory() + "/usage.ini", QSettings::IniFormat);
+    usage.clear();
+    QDir cacheDir(cacheDirectory());
+    foreach (const QString &fileName, m_lastUsed.keys()) {
+        usage.setValue(cacheDir.relativeFilePath(fileName), m_lastUsed.value(fileName));
+    }
+}
+
+void ZigbeeFirmwareCacheManager::scheduleStoreUsage()
+{
+    // Not restarted on further changes, so a steady stream of them still gets written
+    if (!m_usageTimer.isActive()) {
+        m_usageTimer.start();
+    }
+}
+
+void ZigbeeFirmwareCacheManager::scheduleCleanup()
+{
+    m_cleanupTimer.start();
+}
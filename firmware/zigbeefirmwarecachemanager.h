@@ -0,0 +1,99 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWARECACHEMANAGER_H
+#define ZIGBEEFIRMWARECACHEMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+// Keeps the downloaded firmware images within a byte budget. Images which are no longer listed in any
+// firmware index are removed, if the cache still exceeds the budget the least recently used images are
+// evicted. Images pinned by a plugin, e.g. because a managed node needs them, are never removed.
+// The cache directory is the same for all zigbee plugins, so this manager is shared by all of them.
+class ZigbeeFirmwareCacheManager: public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns the cache manager shared by all plugins, see ZigbeeSharedRegistry
+    static ZigbeeFirmwareCacheManager *acquire(QObject *subscriber);
+    void release(QObject *subscriber);
+
+    static QString cacheDirectory();
+
+    // Default is 64 MiB
+    qint64 budget() const;
+    void setBudget(qint64 budget);
+
+    // All images listed in the firmware index of the subscriber. Cached images not listed by any subscriber
+    // have been superseded and are removed. Nothing is pruned before every subscriber has reported its images.
+    void setIndexedImages(QObject *subscriber, const QSet<QString> &fileNames);
+
+    // Images the subscriber needs for its things. Those are never removed.
+    void setPinnedImages(QObject *subscriber, const QSet<QString> &fileNames);
+
+    // Marks an image as used now. Usage is written to disk in batches.
+    void touch(const QString &fileName);
+
+    qint64 cacheSize() const;
+
+public slots:
+    void cleanup();
+
+private:
+    explicit ZigbeeFirmwareCacheManager(QObject *parent = nullptr);
+    ~ZigbeeFirmwareCacheManager() override;
+
+    struct CachedImage {
+        QString fileName;
+        qint64 size = 0;
+        qint64 lastUsed = 0;
+        qint64 lastModified = 0;
+    };
+    QList<CachedImage> cachedImages() const;
+    bool removeImage(const CachedImage &image);
+    void loadUsage();
+    void storeUsage();
+    void scheduleStoreUsage();
+    void scheduleCleanup();
+
+    QHash<QObject*, QSet<QString>> m_indexedImages;
+    QHash<QObject*, QSet<QString>> m_pinnedImages;
+    QHash<QString, qint64> m_lastUsed;
+    qint64 m_budget = 64 * 1024 * 1024;
+    QTimer m_cleanupTimer;
+    QTimer m_usageTimer;
+};
+
+#endif // ZIGBEEFIRMWARECACHEMANAGER_H
@@ -0,0 +1,136 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwarecatalog.h"
+
+#include <algorithm>
+
+ZigbeeFirmwareCatalog::ZigbeeFirmwareCatalog(const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    setEntries(entries);
+}
+
+void ZigbeeFirmwareCatalog::setEntries(const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    m_entries.clear();
+    m_buckets.clear();
+    m_exactIndex.clear();
+
+    m_entries.reserve(entries.count());
+    foreach (const ZigbeeFirmwareIndexEntry &entry, entries) {
+        m_entries.append(entry);
+    }
+
+    // Stable, so duplicates keep the order of the index and the first one wins in exact lookups
+    std::stable_sort(m_entries.begin(), m_entries.end(), [](const ZigbeeFirmwareIndexEntry &a, const ZigbeeFirmwareIndexEntry &b){
+        quint32 keyA = bucketKey(a.manufacturerCode, a.imageType);
+        quint32 keyB = bucketKey(b.manufacturerCode, b.imageType);
+        if (keyA != keyB) {
+            return keyA < keyB;
+        }
+        return a.fileVersion < b.fileVersion;
+    });
+
+    m_exactIndex.reserve(m_entries.count());
+    for (int i = 0; i < m_entries.count(); i++) {
+        const ZigbeeFirmwareIndexEntry &entry = m_entries.at(i);
+        quint32 key = bucketKey(entry.manufacturerCode, entry.imageType);
+        if (!m_buckets.contains(key)) {
+            m_buckets[key].begin = i;
+        }
+        m_buckets[key].end = i + 1;
+
+        quint64 exactKey = entryKey(entry.manufacturerCode, entry.imageType, entry.fileVersion);
+        if (!m_exactIndex.contains(exactKey)) {
+            m_exactIndex.insert(exactKey, i);
+        }
+    }
+}
+
+QList<ZigbeeFirmwareIndexEntry> ZigbeeFirmwareCatalog::entries() const
+{
+    return m_entries.toList();
+}
+
+int ZigbeeFirmwareCatalog::count() const
+{
+    return m_entries.count();
+}
+
+bool ZigbeeFirmwareCatalog::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+ZigbeeFirmwareIndexEntry ZigbeeFirmwareCatalog::find(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion) const
+{
+    int index = m_exactIndex.value(entryKey(manufacturerCode, imageType, fileVersion), -1);
+    if (index < 0) {
+        return ZigbeeFirmwareIndexEntry();
+    }
+    return m_entries.at(index);
+}
+
+ZigbeeFirmwareIndexEntry ZigbeeFirmwareCatalog::findUpdate(quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelId) const
+{
+    if (!m_buckets.contains(bucketKey(manufacturerCode, imageType))) {
+        return ZigbeeFirmwareIndexEntry();
+    }
+    Bucket bucket = m_buckets.value(bucketKey(manufacturerCode, imageType));
+
+    // First entry with a version greater than the current one. Everything behind it is a candidate.
+    QVector<ZigbeeFirmwareIndexEntry>::const_iterator first = std::upper_bound(m_entries.constBegin() + bucket.begin, m_entries.constBegin() + bucket.end, currentFileVersion,
+                                                                              [](quint32 version, const ZigbeeFirmwareIndexEntry &entry){
+        return version < entry.fileVersion;
+    });
+
+    // Walk from the newest candidate downwards, the first applicable one is the best match
+    QVector<ZigbeeFirmwareIndexEntry>::const_iterator it = m_entries.constBegin() + bucket.end;
+    while (it != first) {
+        --it;
+        if ((it->minFileVersion == 0 || it->minFileVersion <= currentFileVersion)
+                && (it->maxFileVersion == 0 || it->maxFileVersion >= currentFileVersion)
+                && (it->modelId.isEmpty() || it->modelId == modelId)) {
+            return *it;
+        }
+    }
+    return ZigbeeFirmwareIndexEntry();
+}
+
+quint32 ZigbeeFirmwareCatalog::bucketKey(quint16 manufacturerCode, quint16 imageType)
+{
+    return (static_cast<quint32>(manufacturerCode) << 16) | imageType;
+}
+
+quint64 ZigbeeFirmwareCatalog::entryKey(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion)
+{
+    return (static_cast<quint64>(bucketKey(manufacturerCode, imageType)) << 32) | fileVersion;
+}
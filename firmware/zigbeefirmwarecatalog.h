@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWARECATALOG_H
+#define ZIGBEEFIRMWARECATALOG_H
+
+#include <QHash>
+#include <QList>
+#include <QUrl>
+#include <QVector>
+
+class ZigbeeFirmwareIndexEntry
+{
+public:
+    quint16 manufacturerCode = 0;
+    quint16 imageType = 0;
+    quint32 fileVersion = 0;
+    quint32 minFileVersion = 0;
+    quint32 maxFileVersion = 0;
+    quint32 fileSize = 0;
+    QString modelId;
+    QUrl url;
+    QByteArray sha512;
+};
+
+// Indexed view on a firmware index. Entries are grouped in buckets per (manufacturerCode, imageType),
+// each bucket sorted by file version, so lookups don't need to walk the entire index.
+class ZigbeeFirmwareCatalog
+{
+public:
+    ZigbeeFirmwareCatalog() = default;
+    explicit ZigbeeFirmwareCatalog(const QList<ZigbeeFirmwareIndexEntry> &entries);
+
+    void setEntries(const QList<ZigbeeFirmwareIndexEntry> &entries);
+    QList<ZigbeeFirmwareIndexEntry> entries() const;
+
+    int count() const;
+    bool isEmpty() const;
+
+    // Exact match, O(1)
+    ZigbeeFirmwareIndexEntry find(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion) const;
+
+    // Newest image newer than currentFileVersion which is applicable for the given model and current version
+    ZigbeeFirmwareIndexEntry findUpdate(quint16 manufacturerCode, quint16 imageType, quint32 currentFileVersion, const QString &modelId) const;
+
+private:
+    struct Bucket {
+        int begin = 0;
+        int end = 0;
+    };
+
+    static quint32 bucketKey(quint16 manufacturerCode, quint16 imageType);
+    static quint64 entryKey(quint16 manufacturerCode, quint16 imageType, quint32 fileVersion);
+
+    // Sorted by bucket key, then ascending file version
+    QVector<ZigbeeFirmwareIndexEntry> m_entries;
+    QHash<quint32, Bucket> m_buckets;
+    QHash<quint64, int> m_exactIndex;
+};
+
+#endif // ZIGBEEFIRMWARECATALOG_H
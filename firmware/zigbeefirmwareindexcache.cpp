@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareindexcache.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+
+bool ZigbeeFirmwareIndexCache::write(const QString &fileName, const QFileInfo &source, const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    QByteArray records;
+    records.reserve(entries.count() * static_cast<int>(sizeof(Record)));
+    QByteArray stringPool;
+
+    foreach (const ZigbeeFirmwareIndexEntry &entry, entries) {
+        QByteArray modelId = entry.modelId.toUtf8();
+        QByteArray url = entry.url.toEncoded();
+
+        Record record;
+        record.manufacturerCode = entry.manufacturerCode;
+        record.imageType = entry.imageType;
+        record.fileVersion = entry.fileVersion;
+        record.minFileVersion = entry.minFileVersion;
+        record.maxFileVersion = entry.maxFileVersion;
+        record.fileSize = entry.fileSize;
+        record.modelIdOffset = static_cast<quint32>(stringPool.size());
+        record.modelIdLength = static_cast<quint32>(modelId.size());
+        stringPool.append(modelId);
+        record.urlOffset = static_cast<quint32>(stringPool.size());
+        record.urlLength = static_cast<quint32>(url.size());
+        stringPool.append(url);
+        record.sha512Offset = static_cast<quint32>(stringPool.size());
+        record.sha512Length = static_cast<quint32>(entry.sha512.size());
+        stringPool.append(entry.sha512);
+
+        records.append(reinterpret_cast<const char*>(&record), sizeof(Record));
+    }
+
+    QByteArray payload = records + stringPool;
+
+    Header header;
+    header.magic = magic;
+    header.formatVersion = formatVersion;
+    header.sourceSize = static_cast<quint64>(source.size());
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.entryCount = static_cast<quint32>(entries.count());
+    header.stringPoolSize = static_cast<quint32>(stringPool.size());
+    header.checksum = checksum(payload.constData(), static_cast<quint64>(payload.size()));
+    header.reserved = 0;
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(payload);
+    return file.commit();
+}
+
+bool ZigbeeFirmwareIndexCache::read(const QString &fileName, const QFileInfo &source, QList<ZigbeeFirmwareIndexEntry> *entries)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    quint64 fileSize = static_cast<quint64>(file.size());
+    if (fileSize < sizeof(Header)) {
+        return false;
+    }
+    const uchar *data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header*>(data);
+    if (header->magic != magic || header->formatVersion != formatVersion) {
+        return false;
+    }
+    if (header->sourceSize != static_cast<quint64>(source.size()) || header->sourceModified != source.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+
+    quint64 recordsSize = static_cast<quint64>(header->entryCount) * sizeof(Record);
+    if (sizeof(Header) + recordsSize + header->stringPoolSize != fileSize) {
+        return false;
+    }
+
+    const char *payload = reinterpret_cast<const char*>(data) + sizeof(Header);
+    if (checksum(payload, recordsSize + header->stringPoolSize) != header->checksum) {
+        return false;
+    }
+
+    // Records are decoded right away, the catalog builds its lookup tables from the decoded entries anyways
+    const Record *records = reinterpret_cast<const Record*>(payload);
+    const char *stringPool = payload + recordsSize;
+    quint64 stringPoolSize = header->stringPoolSize;
+
+    QList<ZigbeeFirmwareIndexEntry> ret;
+    ret.reserve(static_cast<int>(header->entryCount));
+    for (quint32 i = 0; i < header->entryCount; i++) {
+        const Record &record = records[i];
+        if (static_cast<quint64>(record.modelIdOffset) + record.modelIdLength > stringPoolSize
+                || static_cast<quint64>(record.urlOffset) + record.urlLength > stringPoolSize
+                || static_cast<quint64>(record.sha512Offset) + record.sha512Length > stringPoolSize) {
+            return false;
+        }
+
+        ZigbeeFirmwareIndexEntry entry;
+        entry.manufacturerCode = record.manufacturerCode;
+        entry.imageType = record.imageType;
+        entry.fileVersion = record.fileVersion;
+        entry.minFileVersion = record.minFileVersion;
+        entry.maxFileVersion = record.maxFileVersion;
+        entry.fileSize = record.fileSize;
+        entry.modelId = QString::fromUtf8(stringPool + record.modelIdOffset, static_cast<int>(record.modelIdLength));
+        entry.url = QUrl::fromEncoded(QByteArray(stringPool + record.urlOffset, static_cast<int>(record.urlLength)));
+        entry.sha512 = QByteArray(stringPool + record.sha512Offset, static_cast<int>(record.sha512Length));
+        ret.append(entry);
+    }
+
+    *entries = ret;
+    return true;
+}
+
+quint32 ZigbeeFirmwareIndexCache::checksum(const char *data, quint64 length)
+{
+    // FNV-1a, only meant to detect truncated or otherwise corrupted files
+    quint32 hash = 2166136261u;
+    for (quint64 i = 0; i < length; i++) {
+        hash ^= static_cast<quint8>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
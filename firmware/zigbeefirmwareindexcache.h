@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWAREINDEXCACHE_H
+#define ZIGBEEFIRMWAREINDEXCACHE_H
+
+#include "zigbeefirmwarecatalog.h"
+
+#include <QFileInfo>
+
+// Binary on-disk cache of a parsed firmware index. The file consists of a header, a table of fixed
+// size records and a string pool. The cache is bound to the size and modification time of the JSON
+// source it has been generated from and is considered stale as soon as the source changes.
+//
+// Loading is still linear in the size of the index: the payload is checksummed and every record is
+// decoded into a ZigbeeFirmwareIndexEntry. What it saves is the JSON tokenizing, the QVariantMap
+// detour and the escape handling, which make up most of the cost of parsing the JSON index.
+class ZigbeeFirmwareIndexCache
+{
+public:
+    static const quint32 magic = 0x5a465749; // "ZFWI"
+    static const quint32 formatVersion = 1;
+
+    static bool write(const QString &fileName, const QFileInfo &source, const QList<ZigbeeFirmwareIndexEntry> &entries);
+    static bool read(const QString &fileName, const QFileInfo &source, QList<ZigbeeFirmwareIndexEntry> *entries);
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 formatVersion;
+        quint64 sourceSize;
+        qint64 sourceModified;
+        quint32 entryCount;
+        quint32 stringPoolSize;
+        quint32 checksum;
+        quint32 reserved;
+    };
+
+    struct Record {
+        quint16 manufacturerCode;
+        quint16 imageType;
+        quint32 fileVersion;
+        quint32 minFileVersion;
+        quint32 maxFileVersion;
+        quint32 fileSize;
+        quint32 modelIdOffset;
+        quint32 modelIdLength;
+        quint32 urlOffset;
+        quint32 urlLength;
+        quint32 sha512Offset;
+        quint32 sha512Length;
+    };
+
+    static quint32 checksum(const char *data, quint64 length);
+};
+
+#endif // ZIGBEEFIRMWAREINDEXCACHE_H
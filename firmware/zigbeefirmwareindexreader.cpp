@@ -0,0 +1,348 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareindexreader.h"
+
+QString ZigbeeFirmwareIndexReader::Value::toString() const
+{
+    if (type == TypeNull) {
+        return QString();
+    }
+    if (escaped) {
+        return QString::fromUtf8(unescape(data, length));
+    }
+    return QString::fromUtf8(data, length);
+}
+
+QByteArray ZigbeeFirmwareIndexReader::Value::toByteArray() const
+{
+    if (type == TypeNull) {
+        return QByteArray();
+    }
+    if (escaped) {
+        return unescape(data, length);
+    }
+    return QByteArray(data, length);
+}
+
+quint32 ZigbeeFirmwareIndexReader::Value::toUInt() const
+{
+    if (type == TypeBool) {
+        return length == 4 ? 1 : 0; // true
+    }
+    if (type != TypeNumber && type != TypeString) {
+        return 0;
+    }
+    // Numbers in strings are accepted too, just like QVariant::toUInt() did
+    QByteArray raw = QByteArray::fromRawData(data, length);
+    bool ok = false;
+    quint32 ret = raw.toUInt(&ok);
+    if (!ok) {
+        double value = raw.toDouble(&ok);
+        ret = ok && value > 0 ? static_cast<quint32>(value) : 0;
+    }
+    return ret;
+}
+
+ZigbeeFirmwareIndexReader::ZigbeeFirmwareIndexReader(const QByteArray &data):
+    m_data(data)
+{
+
+}
+
+QList<ZigbeeFirmwareIndexEntry> ZigbeeFirmwareIndexReader::read(const FieldHandler &fieldHandler)
+{
+    QList<ZigbeeFirmwareIndexEntry> ret;
+    m_errorString.clear();
+    m_pos = m_data.constData();
+    m_end = m_pos + m_data.size();
+
+    skipWhitespace();
+    if (!expect('[')) {
+        return QList<ZigbeeFirmwareIndexEntry>();
+    }
+
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == ']') {
+        return ret;
+    }
+
+    while (m_pos < m_end) {
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == '{') {
+            ZigbeeFirmwareIndexEntry entry;
+            if (!readObject(&entry, fieldHandler)) {
+                return QList<ZigbeeFirmwareIndexEntry>();
+            }
+            ret.append(entry);
+        } else if (!skipValue()) {
+            return QList<ZigbeeFirmwareIndexEntry>();
+        }
+
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == ',') {
+            m_pos++;
+            continue;
+        }
+        if (!expect(']')) {
+            return QList<ZigbeeFirmwareIndexEntry>();
+        }
+        return ret;
+    }
+
+    setError("Unexpected end of data");
+    return QList<ZigbeeFirmwareIndexEntry>();
+}
+
+bool ZigbeeFirmwareIndexReader::hasError() const
+{
+    return !m_errorString.isEmpty();
+}
+
+QString ZigbeeFirmwareIndexReader::errorString() const
+{
+    return m_errorString;
+}
+
+void ZigbeeFirmwareIndexReader::skipWhitespace()
+{
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+        m_pos++;
+    }
+}
+
+bool ZigbeeFirmwareIndexReader::expect(char c)
+{
+    if (m_pos >= m_end || *m_pos != c) {
+        setError(QString("Expected '%1'").arg(c));
+        return false;
+    }
+    m_pos++;
+    return true;
+}
+
+bool ZigbeeFirmwareIndexReader::readString(Value *value)
+{
+    if (!expect('"')) {
+        return false;
+    }
+    value->type = Value::TypeString;
+    value->data = m_pos;
+    value->escaped = false;
+    while (m_pos < m_end) {
+        if (*m_pos == '\\') {
+            // A backslash at the very end has nothing to escape, the string is unterminated
+            if (m_pos + 1 >= m_end) {
+                break;
+            }
+            value->escaped = true;
+            m_pos += 2;
+            continue;
+        }
+        if (*m_pos == '"') {
+            value->length = static_cast<int>(m_pos - value->data);
+            m_pos++;
+            return true;
+        }
+        m_pos++;
+    }
+    setError("Unterminated string");
+    return false;
+}
+
+bool ZigbeeFirmwareIndexReader::readScalar(Value *value)
+{
+    if (m_pos >= m_end) {
+        setError("Unexpected end of data");
+        return false;
+    }
+    if (*m_pos == '"') {
+        return readString(value);
+    }
+
+    const char *start = m_pos;
+    while (m_pos < m_end && *m_pos != ',' && *m_pos != '}' && *m_pos != ']'
+           && *m_pos != ' ' && *m_pos != '\n' && *m_pos != '\r' && *m_pos != '\t') {
+        m_pos++;
+    }
+    value->data = start;
+    value->length = static_cast<int>(m_pos - start);
+    value->escaped = false;
+
+    QLatin1String token(start, value->length);
+    if (token == QLatin1String("null")) {
+        value->type = Value::TypeNull;
+    } else if (token == QLatin1String("true") || token == QLatin1String("false")) {
+        value->type = Value::TypeBool;
+    } else if (value->length > 0 && (*start == '-' || (*start >= '0' && *start <= '9'))) {
+        value->type = Value::TypeNumber;
+    } else {
+        setError(QString("Invalid value \"%1\"").arg(token));
+        return false;
+    }
+    return true;
+}
+
+bool ZigbeeFirmwareIndexReader::skipValue()
+{
+    if (m_pos >= m_end) {
+        setError("Unexpected end of data");
+        return false;
+    }
+    if (*m_pos != '{' && *m_pos != '[') {
+        Value value;
+        return readScalar(&value);
+    }
+
+    int depth = 0;
+    while (m_pos < m_end) {
+        switch (*m_pos) {
+        case '{':
+        case '[':
+            depth++;
+            m_pos++;
+            break;
+        case '}':
+        case ']':
+            depth--;
+            m_pos++;
+            if (depth == 0) {
+                return true;
+            }
+            break;
+        case '"': {
+            Value value;
+            if (!readString(&value)) {
+                return false;
+            }
+            break;
+        }
+        default:
+            m_pos++;
+        }
+    }
+    setError("Unexpected end of data");
+    return false;
+}
+
+bool ZigbeeFirmwareIndexReader::readObject(ZigbeeFirmwareIndexEntry *entry, const FieldHandler &fieldHandler)
+{
+    if (!expect('{')) {
+        return false;
+    }
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == '}') {
+        m_pos++;
+        return true;
+    }
+
+    while (m_pos < m_end) {
+        skipWhitespace();
+        Value key;
+        if (!readString(&key)) {
+            return false;
+        }
+        skipWhitespace();
+        if (!expect(':')) {
+            return false;
+        }
+        skipWhitespace();
+        if (m_pos < m_end && (*m_pos == '{' || *m_pos == '[')) {
+            if (!skipValue()) {
+                return false;
+            }
+        } else {
+            Value value;
+            if (!readScalar(&value)) {
+                return false;
+            }
+            fieldHandler(entry, QLatin1String(key.data, key.length), value);
+        }
+
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == ',') {
+            m_pos++;
+            continue;
+        }
+        return expect('}');
+    }
+
+    setError("Unexpected end of data");
+    return false;
+}
+
+void ZigbeeFirmwareIndexReader::setError(const QString &error)
+{
+    m_errorString = QString("%1 at offset %2").arg(error).arg(m_pos - m_data.constData());
+}
+
+QByteArray ZigbeeFirmwareIndexReader::unescape(const char *data, int length)
+{
+    QByteArray ret;
+    ret.reserve(length);
+    const char *end = data + length;
+    while (data < end) {
+        if (*data != '\\' || data + 1 >= end) {
+            ret.append(*data++);
+            continue;
+        }
+        data++;
+        switch (*data) {
+        case 'b': ret.append('\b'); break;
+        case 'f': ret.append('\f'); break;
+        case 'n': ret.append('\n'); break;
+        case 'r': ret.append('\r'); break;
+        case 't': ret.append('\t'); break;
+        case 'u': {
+            if (data + 4 >= end) {
+                return ret;
+            }
+            uint codePoint = QByteArray(data + 1, 4).toUInt(nullptr, 16);
+            data += 4;
+            // Surrogate pair
+            if (codePoint >= 0xd800 && codePoint < 0xdc00 && data + 6 < end && data[1] == '\\' && data[2] == 'u') {
+                uint low = QByteArray(data + 3, 4).toUInt(nullptr, 16);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    data += 6;
+                }
+            }
+            ret.append(QString::fromUcs4(&codePoint, 1).toUtf8());
+            break;
+        }
+        default:
+            // \" \\ \/
+            ret.append(*data);
+        }
+        data++;
+    }
+    return ret;
+}
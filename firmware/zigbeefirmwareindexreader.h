@@ -0,0 +1,95 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWAREINDEXREADER_H
+#define ZIGBEEFIRMWAREINDEXREADER_H
+
+#include "zigbeefirmwarecatalog.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+
+// Streaming reader for firmware index files which are a JSON array of flat objects.
+// Instead of building a document tree, it walks the raw data once and hands every scalar
+// member of every object to a field handler which fills the entry directly. Nested objects
+// and arrays are skipped.
+class ZigbeeFirmwareIndexReader
+{
+public:
+    class Value {
+    public:
+        enum Type {
+            TypeNull,
+            TypeBool,
+            TypeNumber,
+            TypeString
+        };
+
+        Type type = TypeNull;
+        const char *data = nullptr;
+        int length = 0;
+        bool escaped = false;
+
+        QString toString() const;
+        QByteArray toByteArray() const;
+        quint32 toUInt() const;
+    };
+
+    // Key is only valid for the duration of the call
+    typedef std::function<void(ZigbeeFirmwareIndexEntry *entry, const QLatin1String &key, const Value &value)> FieldHandler;
+
+    explicit ZigbeeFirmwareIndexReader(const QByteArray &data);
+
+    QList<ZigbeeFirmwareIndexEntry> read(const FieldHandler &fieldHandler);
+
+    bool hasError() const;
+    QString errorString() const;
+
+private:
+    void skipWhitespace();
+    bool expect(char c);
+    bool readString(Value *value);
+    bool readScalar(Value *value);
+    bool skipValue();
+    bool readObject(ZigbeeFirmwareIndexEntry *entry, const FieldHandler &fieldHandler);
+    void setError(const QString &error);
+
+    static QByteArray unescape(const char *data, int length);
+
+    QByteArray m_data;
+    const char *m_pos = nullptr;
+    const char *m_end = nullptr;
+    QString m_errorString;
+};
+
+#endif // ZIGBEEFIRMWAREINDEXREADER_H
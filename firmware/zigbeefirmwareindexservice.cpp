@@ -0,0 +1,395 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareindexservice.h"
+#include "zigbeefirmwareindexcache.h"
+#include "zigbeefirmwarerepository.h"
+#include "zigbeefirmwarelogging.h"
+#include "zigbeesharedregistry.h"
+
+#include <QHash>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QSettings>
+
+#include <limits>
+
+// First retry after a failed index update, doubled on each further failure
+static const int retryDelay = 5 * 60;
+
+static ZigbeeSharedRegistry<ZigbeeFirmwareIndexService, QUrl> &services()
+{
+    static ZigbeeSharedRegistry<ZigbeeFirmwareIndexService, QUrl> services;
+    return services;
+}
+
+ZigbeeFirmwareIndexService *ZigbeeFirmwareIndexService::acquire(const QUrl &indexUrl, QObject *subscriber, const Parser &parser)
+{
+    ZigbeeFirmwareIndexService *service = services().acquire(indexUrl, subscriber, [indexUrl](){
+        return new ZigbeeFirmwareIndexService(indexUrl);
+    });
+    service->m_subscribers.append({subscriber, parser});
+    return service;
+}
+
+void ZigbeeFirmwareIndexService::release(QObject *subscriber)
+{
+    for (int i = 0; i < m_subscribers.count(); i++) {
+        if (m_subscribers.at(i).object == subscriber) {
+            m_subscribers.removeAt(i);
+            break;
+        }
+    }
+    services().release(m_indexUrl, this, subscriber);
+}
+
+ZigbeeFirmwareIndexService::ZigbeeFirmwareIndexService(const QUrl &indexUrl, QObject *parent):
+    QObject(parent),
+    m_indexUrl(indexUrl),
+    m_catalog(new ZigbeeFirmwareCatalog()),
+    m_remoteCatalog(m_catalog)
+{
+    m_refreshTimer.setSingleShot(true);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &ZigbeeFirmwareIndexService::fetch);
+}
+
+ZigbeeFirmwareIndexService::~ZigbeeFirmwareIndexService()
+{
+    services().remove(m_indexUrl, this);
+    if (m_pendingReply) {
+        m_pendingReply->disconnect(this);
+        m_pendingReply->abort();
+    }
+    if (m_repository) {
+        m_repository->release(this);
+    }
+}
+
+QUrl ZigbeeFirmwareIndexService::indexUrl() const
+{
+    return m_indexUrl;
+}
+
+QSharedPointer<const ZigbeeFirmwareCatalog> ZigbeeFirmwareIndexService::catalog() const
+{
+    return m_catalog;
+}
+
+QSharedPointer<const ZigbeeFirmwareCatalog> ZigbeeFirmwareIndexService::remoteCatalog() const
+{
+    return m_remoteCatalog;
+}
+
+QString ZigbeeFirmwareIndexService::localRepository() const
+{
+    return m_repository ? m_repository->path() : QString();
+}
+
+void ZigbeeFirmwareIndexService::setLocalRepository(const QString &path)
+{
+    if (m_repository && m_repository->path() == QDir::cleanPath(path)) {
+        return;
+    }
+    if (m_repository) {
+        m_repository->disconnect(this);
+        m_repository->release(this);
+        m_repository = nullptr;
+    }
+    if (!path.isEmpty()) {
+        m_repository = ZigbeeFirmwareRepository::acquire(path, this);
+        connect(m_repository, &ZigbeeFirmwareRepository::entriesChanged, this, &ZigbeeFirmwareIndexService::mergeCatalog);
+    }
+    mergeCatalog();
+}
+
+QDateTime ZigbeeFirmwareIndexService::lastUpdate() const
+{
+    return m_lastUpdate;
+}
+
+QDateTime ZigbeeFirmwareIndexService::nextUpdate() const
+{
+    return m_nextUpdate;
+}
+
+int ZigbeeFirmwareIndexService::refreshInterval() const
+{
+    return m_refreshInterval;
+}
+
+void ZigbeeFirmwareIndexService::setRefreshInterval(int seconds)
+{
+    m_refreshInterval = seconds;
+    // Without a successful update there is nothing to refresh, a pending retry keeps its backoff
+    if (m_fetcher && !m_pendingReply && m_lastUpdate.isValid()) {
+        scheduleUpdate(m_lastUpdate.addSecs(m_refreshInterval));
+    }
+}
+
+void ZigbeeFirmwareIndexService::update(const Fetcher &fetcher)
+{
+    m_fetcher = fetcher;
+
+    if (m_lastUpdate.isNull()) {
+        loadCache();
+        loadValidators();
+    }
+
+    if (m_pendingReply) {
+        qCDebug(dcZigbeeFirmware()) << "Firmware index update already in progress.";
+        return;
+    }
+
+    if (m_lastUpdate.isValid() && m_lastUpdate.addSecs(m_refreshInterval) > QDateTime::currentDateTime()) {
+        scheduleUpdate(m_lastUpdate.addSecs(m_refreshInterval));
+        return;
+    }
+
+    fetch();
+}
+
+void ZigbeeFirmwareIndexService::fetch()
+{
+    if (!m_fetcher || m_pendingReply) {
+        return;
+    }
+    m_refreshTimer.stop();
+    m_nextUpdate = QDateTime();
+
+    QNetworkRequest request(m_indexUrl);
+    // Validators are only of use as long as we still have the data they belong to
+    if (QFileInfo::exists(cacheFileName())) {
+        if (!m_entityTag.isEmpty()) {
+            request.setRawHeader("If-None-Match", m_entityTag);
+        }
+        if (!m_lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", m_lastModified);
+        }
+    }
+
+    QNetworkReply *reply = m_fetcher(request);
+    m_pendingReply = reply;
+    qCDebug(dcZigbeeFirmware()) << "Fetching firmware index...";
+    connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
+    connect(reply, &QNetworkReply::finished, this, [=](){
+        m_pendingReply = nullptr;
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 304) {
+            qCDebug(dcZigbeeFirmware()) << "Firmware index not modified since last update.";
+            m_failedAttempts = 0;
+            m_lastUpdate = QDateTime::currentDateTime();
+            storeValidators();
+            scheduleUpdate(m_lastUpdate.addSecs(m_refreshInterval));
+            return;
+        }
+
+        if (reply->error() != QNetworkReply::NoError) {
+            if (m_remoteCatalog->isEmpty()) {
+                qCWarning(dcZigbeeFirmware()) << "Unable to fetch firmware update index file. Zigbee device firmware updates won't work." << reply->errorString();
+            } else {
+                qCWarning(dcZigbeeFirmware()) << "Unable to fetch firmware update index file. Continuing with the cached index." << reply->errorString();
+            }
+            retryLater();
+            return;
+        }
+
+        QByteArray data = reply->readAll();
+        QList<ZigbeeFirmwareIndexEntry> entries = parse(data);
+        if (entries.isEmpty() && !m_remoteCatalog->isEmpty()) {
+            qCWarning(dcZigbeeFirmware()) << "Fetched firmware index is empty or invalid. Continuing with the cached index.";
+            retryLater();
+            return;
+        }
+
+        m_failedAttempts = 0;
+        setCatalog(entries);
+        m_lastUpdate = QDateTime::currentDateTime();
+        m_entityTag = reply->rawHeader("ETag");
+        m_lastModified = reply->rawHeader("Last-Modified");
+        writeCache(data, entries);
+        storeValidators();
+        scheduleUpdate(m_lastUpdate.addSecs(m_refreshInterval));
+    });
+}
+
+void ZigbeeFirmwareIndexService::scheduleUpdate(const QDateTime &nextUpdate)
+{
+    m_nextUpdate = nextUpdate;
+    qint64 delay = qMax<qint64>(0, QDateTime::currentDateTime().msecsTo(nextUpdate));
+    m_refreshTimer.start(static_cast<int>(qMin<qint64>(delay, std::numeric_limits<int>::max())));
+}
+
+void ZigbeeFirmwareIndexService::retryLater()
+{
+    int delay = static_cast<int>(qMin<qint64>(static_cast<qint64>(retryDelay) << qMin(m_failedAttempts, 16), m_refreshInterval));
+    m_failedAttempts++;
+    qCDebug(dcZigbeeFirmware()) << "Retrying firmware index update in" << delay << "seconds";
+    scheduleUpdate(QDateTime::currentDateTime().addSecs(delay));
+}
+
+QString ZigbeeFirmwareIndexService::cacheFileName() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/zigbee-firmwares/" + m_indexUrl.path();
+}
+
+QString ZigbeeFirmwareIndexService::binaryCacheFileName() const
+{
+    return cacheFileName() + ".bin";
+}
+
+QString ZigbeeFirmwareIndexService::validatorsFileName() const
+{
+    return cacheFileName() + ".validators";
+}
+
+void ZigbeeFirmwareIndexService::loadValidators()
+{
+    if (!QFileInfo::exists(validatorsFileName())) {
+        return;
+    }
+    QSettings validators(validatorsFileName(), QSettings::IniFormat);
+    m_entityTag = validators.value("etag").toByteArray();
+    m_lastModified = validators.value("lastModified").toByteArray();
+
+    // A "not modified" response doesn't touch the cache file, so the last check is stored separately
+    QDateTime lastCheck = validators.value("lastCheck").toDateTime();
+    if (lastCheck.isValid() && (m_lastUpdate.isNull() || lastCheck > m_lastUpdate)) {
+        m_lastUpdate = lastCheck;
+    }
+}
+
+void ZigbeeFirmwareIndexService::storeValidators()
+{
+    QSettings validators(validatorsFileName(), QSettings::IniFormat);
+    validators.setValue("etag", m_entityTag);
+    validators.setValue("lastModified", m_lastModified);
+    validators.setValue("lastCheck", m_lastUpdate);
+}
+
+void ZigbeeFirmwareIndexService::loadCache()
+{
+    QFileInfo cacheFileInfo(cacheFileName());
+    if (!cacheFileInfo.exists()) {
+        return;
+    }
+
+    QList<ZigbeeFirmwareIndexEntry> entries;
+    if (ZigbeeFirmwareIndexCache::read(binaryCacheFileName(), cacheFileInfo, &entries)) {
+        qCDebug(dcZigbeeFirmware()) << "Loaded firmware index from binary cache" << binaryCacheFileName();
+        setCatalog(entries);
+        m_lastUpdate = cacheFileInfo.lastModified();
+        return;
+    }
+
+    qCDebug(dcZigbeeFirmware()) << "Binary firmware index cache missing or stale. Parsing" << cacheFileInfo.absoluteFilePath();
+    QFile cache(cacheFileInfo.absoluteFilePath());
+    if (!cache.open(QFile::ReadOnly)) {
+        qCWarning(dcZigbeeFirmware()) << "Unable to open firmware index cache file" << cacheFileInfo.absoluteFilePath();
+        return;
+    }
+    entries = parse(cache.readAll());
+    cache.close();
+    setCatalog(entries);
+    m_lastUpdate = cacheFileInfo.lastModified();
+    writeBinaryCache(cacheFileInfo, entries);
+}
+
+void ZigbeeFirmwareIndexService::writeCache(const QByteArray &data, const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    QFileInfo cacheFileInfo(cacheFileName());
+    QDir cacheDir(cacheFileInfo.absolutePath());
+    if (!cacheDir.exists() && !cacheDir.mkpath(cacheFileInfo.absolutePath())) {
+        qCWarning(dcZigbeeFirmware()) << "Unable to create cache file path" << cacheFileInfo.absolutePath();
+        return;
+    }
+    QFile cache(cacheFileInfo.absoluteFilePath());
+    if (!cache.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcZigbeeFirmware()) << "Unable to open cache file for writing" << cacheFileInfo.absoluteFilePath();
+        return;
+    }
+    cache.write(data);
+    cache.close();
+
+    cacheFileInfo.refresh();
+    writeBinaryCache(cacheFileInfo, entries);
+}
+
+void ZigbeeFirmwareIndexService::writeBinaryCache(const QFileInfo &source, const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    // Don't cache failed parse results, the JSON would never be looked at again otherwise
+    if (entries.isEmpty()) {
+        QFile::remove(binaryCacheFileName());
+        return;
+    }
+    if (!ZigbeeFirmwareIndexCache::write(binaryCacheFileName(), source, entries)) {
+        qCWarning(dcZigbeeFirmware()) << "Unable to write binary firmware index cache" << binaryCacheFileName();
+    }
+}
+
+void ZigbeeFirmwareIndexService::setCatalog(const QList<ZigbeeFirmwareIndexEntry> &entries)
+{
+    m_remoteCatalog = QSharedPointer<const ZigbeeFirmwareCatalog>(new ZigbeeFirmwareCatalog(entries));
+    qCDebug(dcZigbeeFirmware()) << "Firmware index for" << m_indexUrl.toString() << "contains" << m_remoteCatalog->count() << "images";
+    mergeCatalog();
+}
+
+void ZigbeeFirmwareIndexService::mergeCatalog()
+{
+    QList<ZigbeeFirmwareIndexEntry> localEntries = m_repository ? m_repository->entries() : QList<ZigbeeFirmwareIndexEntry>();
+    if (localEntries.isEmpty()) {
+        m_catalog = m_remoteCatalog;
+    } else {
+        // Local images take precedence over remote ones with the same identity
+        ZigbeeFirmwareCatalog localCatalog(localEntries);
+        QList<ZigbeeFirmwareIndexEntry> entries = localEntries;
+        foreach (const ZigbeeFirmwareIndexEntry &entry, m_remoteCatalog->entries()) {
+            if (localCatalog.find(entry.manufacturerCode, entry.imageType, entry.fileVersion).fileVersion == 0) {
+                entries.append(entry);
+            }
+        }
+        m_catalog = QSharedPointer<const ZigbeeFirmwareCatalog>(new ZigbeeFirmwareCatalog(entries));
+    }
+    emit catalogChanged();
+}
+
+QList<ZigbeeFirmwareIndexEntry> ZigbeeFirmwareIndexService::parse(const QByteArray &data) const
+{
+    // All subscribers of the same index url use the same format. Always use the oldest one so the result
+    // doesn't depend on the order plugins have been loaded in once it is running.
+    if (m_subscribers.isEmpty()) {
+        return QList<ZigbeeFirmwareIndexEntry>();
+    }
+    return m_subscribers.first().parser(data);
+}
@@ -0,0 +1,133 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWAREINDEXSERVICE_H
+#define ZIGBEEFIRMWAREINDEXSERVICE_H
+
+#include "zigbeefirmwarecatalog.h"
+
+#include <QObject>
+#include <QUrl>
+#include <QList>
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QTimer>
+
+#include <functional>
+
+class QNetworkRequest;
+class QNetworkReply;
+class QFileInfo;
+class ZigbeeFirmwareRepository;
+
+// Fetches, caches and parses a firmware index once per process and index url. All plugins using
+// the same index share one service instance and get the same immutable catalog. Images from a
+// local repository directory are merged into that catalog.
+class ZigbeeFirmwareIndexService: public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<QList<ZigbeeFirmwareIndexEntry>(const QByteArray &data)> Parser;
+    typedef std::function<QNetworkReply*(const QNetworkRequest &request)> Fetcher;
+
+    // Returns the service of the url shared by all plugins, see ZigbeeSharedRegistry.
+    // All subscribers of an url are expected to understand the same format, the parser of the oldest subscriber is used.
+    static ZigbeeFirmwareIndexService *acquire(const QUrl &indexUrl, QObject *subscriber, const Parser &parser);
+    void release(QObject *subscriber);
+
+    QUrl indexUrl() const;
+    // The remote index with the local images merged in. Local images win over remote ones with the same identity.
+    QSharedPointer<const ZigbeeFirmwareCatalog> catalog() const;
+    // The remote index only, empty as long as it hasn't been loaded
+    QSharedPointer<const ZigbeeFirmwareCatalog> remoteCatalog() const;
+
+    // Directory with OTA image files to merge into the catalog. Shared by all subscribers, the last one set is used.
+    QString localRepository() const;
+    void setLocalRepository(const QString &path);
+    QDateTime lastUpdate() const;
+    // When the next fetch is due, either a regular refresh or a retry. Invalid while none is scheduled.
+    QDateTime nextUpdate() const;
+
+    // The index is refreshed periodically once update() has been called. Default is once a day.
+    int refreshInterval() const;
+    void setRefreshInterval(int seconds);
+
+    // The fetcher is kept for periodic refreshes and must stay valid for as long as the service lives
+    void update(const Fetcher &fetcher);
+
+signals:
+    void catalogChanged();
+
+private:
+    struct Subscriber {
+        QObject *object;
+        Parser parser;
+    };
+
+    explicit ZigbeeFirmwareIndexService(const QUrl &indexUrl, QObject *parent = nullptr);
+    ~ZigbeeFirmwareIndexService() override;
+
+    QString cacheFileName() const;
+    QString binaryCacheFileName() const;
+    QString validatorsFileName() const;
+    void loadValidators();
+    void storeValidators();
+    void fetch();
+    void scheduleUpdate(const QDateTime &nextUpdate);
+    void retryLater();
+    void loadCache();
+    void writeCache(const QByteArray &data, const QList<ZigbeeFirmwareIndexEntry> &entries);
+    void writeBinaryCache(const QFileInfo &source, const QList<ZigbeeFirmwareIndexEntry> &entries);
+    void setCatalog(const QList<ZigbeeFirmwareIndexEntry> &entries);
+    void mergeCatalog();
+    QList<ZigbeeFirmwareIndexEntry> parse(const QByteArray &data) const;
+
+    QUrl m_indexUrl;
+    QList<Subscriber> m_subscribers;
+    QSharedPointer<const ZigbeeFirmwareCatalog> m_catalog;
+    QSharedPointer<const ZigbeeFirmwareCatalog> m_remoteCatalog;
+    ZigbeeFirmwareRepository *m_repository = nullptr;
+    QDateTime m_lastUpdate;
+    QDateTime m_nextUpdate;
+    QNetworkReply *m_pendingReply = nullptr;
+    Fetcher m_fetcher;
+
+    // Conditional requests
+    QByteArray m_entityTag;
+    QByteArray m_lastModified;
+
+    int m_refreshInterval = 60 * 60 * 24;
+    int m_failedAttempts = 0;
+    QTimer m_refreshTimer;
+};
+
+#endif // ZIGBEEFIRMWAREINDEXSERVICE_H
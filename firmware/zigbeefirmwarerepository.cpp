@@ -0,0 +1,169 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwarerepository.h"
+#include "zigbeeotaimageheader.h"
+#include "zigbeefirmwarelogging.h"
+#include "zigbeesharedregistry.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QDir>
+#include <QUrl>
+
+// Vendor specific container data in front of the OTA header is expected to be small
+static const int headerSearchLength = 64 * 1024;
+
+static ZigbeeSharedRegistry<ZigbeeFirmwareRepository, QString> &repositories()
+{
+    static ZigbeeSharedRegistry<ZigbeeFirmwareRepository, QString> repositories;
+    return repositories;
+}
+
+ZigbeeFirmwareRepository *ZigbeeFirmwareRepository::acquire(const QString &path, QObject *subscriber)
+{
+    QString cleanPath = QDir::cleanPath(path);
+    return repositories().acquire(cleanPath, subscriber, [cleanPath](){
+        return new ZigbeeFirmwareRepository(cleanPath);
+    });
+}
+
+void ZigbeeFirmwareRepository::release(QObject *subscriber)
+{
+    repositories().release(m_path, this, subscriber);
+}
+
+ZigbeeFirmwareRepository::ZigbeeFirmwareRepository(const QString &path, QObject *parent):
+    QObject(parent),
+    m_path(path)
+{
+    // Files are usually copied into the directory, wait until that settled before reading them
+    m_rescanTimer.setSingleShot(true);
+    m_rescanTimer.setInterval(2000);
+    connect(&m_rescanTimer, &QTimer::timeout, this, &ZigbeeFirmwareRepository::rescan);
+
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, &m_rescanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, &m_rescanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+
+    if (QDir(m_path).exists()) {
+        m_watcher.addPath(m_path);
+    }
+    rescan();
+}
+
+ZigbeeFirmwareRepository::~ZigbeeFirmwareRepository()
+{
+    repositories().remove(m_path, this);
+}
+
+QString ZigbeeFirmwareRepository::path() const
+{
+    return m_path;
+}
+
+QList<ZigbeeFirmwareIndexEntry> ZigbeeFirmwareRepository::entries() const
+{
+    QList<ZigbeeFirmwareIndexEntry> entries;
+    foreach (const File &file, m_files) {
+        if (file.valid) {
+            entries.append(file.entry);
+        }
+    }
+    return entries;
+}
+
+void ZigbeeFirmwareRepository::rescan()
+{
+    bool changed = false;
+    QHash<QString, File> files;
+    foreach (const QFileInfo &fileInfo, QDir(m_path).entryInfoList(QDir::Files)) {
+        QString fileName = fileInfo.absoluteFilePath();
+        File file = m_files.value(fileName);
+        qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        if (!m_files.contains(fileName) || file.size != fileInfo.size() || file.lastModified != lastModified) {
+            file = File();
+            file.size = fileInfo.size();
+            file.lastModified = lastModified;
+            file.valid = readEntry(fileInfo, &file.entry);
+            if (file.valid) {
+                qCDebug(dcZigbeeFirmware()) << "Found local firmware image" << fileName << file.entry.manufacturerCode << file.entry.imageType << file.entry.fileVersion;
+            } else {
+                qCDebug(dcZigbeeFirmware()) << "Ignoring file in local firmware repository" << fileName;
+            }
+            changed = true;
+        }
+        files.insert(fileName, file);
+    }
+    if (files.count() != m_files.count()) {
+        changed = true;
+    }
+    m_files = files;
+
+    // Modifying a file in place doesn't change the directory, watch the files too
+    QStringList watchedFiles = m_watcher.files();
+    foreach (const QString &fileName, m_files.keys()) {
+        if (!watchedFiles.contains(fileName)) {
+            m_watcher.addPath(fileName);
+        }
+    }
+
+    if (changed) {
+        emit entriesChanged();
+    }
+}
+
+bool ZigbeeFirmwareRepository::readEntry(const QFileInfo &fileInfo, ZigbeeFirmwareIndexEntry *entry) const
+{
+    QFile file(fileInfo.absoluteFilePath());
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray data = file.read(headerSearchLength);
+    ZigbeeOtaImageHeader header;
+    ZigbeeOtaImageHeader::ParseResult result;
+    int offset = ZigbeeOtaImageHeader::find(data.constData(), data.length(), &header, &result);
+    if (offset < 0 || result != ZigbeeOtaImageHeader::ParseResultOk) {
+        return false;
+    }
+    if (fileInfo.size() - offset < header.totalImageSize) {
+        qCWarning(dcZigbeeFirmware()) << "Local firmware image" << fileInfo.absoluteFilePath() << "is truncated";
+        return false;
+    }
+
+    entry->manufacturerCode = header.manufacturerCode;
+    entry->imageType = header.imageType;
+    entry->fileVersion = header.fileVersion;
+    entry->fileSize = header.totalImageSize;
+    entry->url = QUrl::fromLocalFile(fileInfo.absoluteFilePath());
+    return true;
+}
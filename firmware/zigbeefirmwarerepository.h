@@ -0,0 +1,84 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEFIRMWAREREPOSITORY_H
+#define ZIGBEEFIRMWAREREPOSITORY_H
+
+#include "zigbeefirmwarecatalog.h"
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <QSet>
+
+class QFileInfo;
+
+// A local directory with OTA image files, e.g. for sites without internet access. The index entries are
+// taken from the OTA headers of the files. The directory is watched, on changes only new or modified
+// files are read again. Subdirectories are not scanned. There is one repository per directory and process.
+class ZigbeeFirmwareRepository: public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns the repository of the directory shared by all plugins, see ZigbeeSharedRegistry
+    static ZigbeeFirmwareRepository *acquire(const QString &path, QObject *subscriber);
+    void release(QObject *subscriber);
+
+    QString path() const;
+    QList<ZigbeeFirmwareIndexEntry> entries() const;
+
+    void rescan();
+
+signals:
+    void entriesChanged();
+
+private:
+    explicit ZigbeeFirmwareRepository(const QString &path, QObject *parent = nullptr);
+    ~ZigbeeFirmwareRepository() override;
+
+    bool readEntry(const QFileInfo &fileInfo, ZigbeeFirmwareIndexEntry *entry) const;
+
+    struct File {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        bool valid = false;
+        ZigbeeFirmwareIndexEntry entry;
+    };
+
+    QString m_path;
+    QHash<QString, File> m_files;
+    QFileSystemWatcher m_watcher;
+    QTimer m_rescanTimer;
+};
+
+#endif // ZIGBEEFIRMWAREREPOSITORY_H
@@ -0,0 +1,146 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotaimageheader.h"
+
+#include <QtEndian>
+
+#include <string.h>
+#include <stddef.h>
+
+#pragma pack(push, 1)
+struct ZigbeeOtaRawImageHeader {
+    quint32 fileIdentifier;
+    quint16 headerVersion;
+    quint16 headerLength;
+    quint16 fieldControl;
+    quint16 manufacturerCode;
+    quint16 imageType;
+    quint32 fileVersion;
+    quint16 zigbeeStackVersion;
+    char headerString[32];
+    quint32 totalImageSize;
+};
+#pragma pack(pop)
+
+Q_STATIC_ASSERT(sizeof(ZigbeeOtaRawImageHeader) == ZigbeeOtaImageHeader::minimumLength);
+
+// Little endian representation of the file identifier
+static const char rawFileIdentifier[] = { '\x1e', '\xf1', '\xee', '\x0b' };
+
+int ZigbeeOtaImageHeader::locate(const char *data, int length, int from)
+{
+    if (from < 0 || from >= length) {
+        return -1;
+    }
+    const void *match = memmem(data + from, static_cast<size_t>(length - from), rawFileIdentifier, sizeof(rawFileIdentifier));
+    if (!match) {
+        return -1;
+    }
+    return static_cast<int>(static_cast<const char*>(match) - data);
+}
+
+ZigbeeOtaImageHeader::ParseResult ZigbeeOtaImageHeader::parse(const char *data, int length, ZigbeeOtaImageHeader *header)
+{
+    if (length < minimumLength) {
+        return ParseResultIncomplete;
+    }
+
+    const ZigbeeOtaRawImageHeader *raw = reinterpret_cast<const ZigbeeOtaRawImageHeader*>(data);
+    if (qFromLittleEndian<quint32>(data + offsetof(ZigbeeOtaRawImageHeader, fileIdentifier)) != fileIdentifier) {
+        return ParseResultInvalid;
+    }
+
+    ZigbeeOtaImageHeader ret;
+    ret.headerVersion = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, headerVersion));
+    ret.headerLength = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, headerLength));
+    ret.fieldControl = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, fieldControl));
+    ret.manufacturerCode = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, manufacturerCode));
+    ret.imageType = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, imageType));
+    ret.fileVersion = qFromLittleEndian<quint32>(data + offsetof(ZigbeeOtaRawImageHeader, fileVersion));
+    ret.zigbeeStackVersion = qFromLittleEndian<quint16>(data + offsetof(ZigbeeOtaRawImageHeader, zigbeeStackVersion));
+    ret.totalImageSize = qFromLittleEndian<quint32>(data + offsetof(ZigbeeOtaRawImageHeader, totalImageSize));
+
+    // Sanity checks, mostly to sort out random occurrences of the identifier in vendor containers.
+    // Newer header versions may append fields, which readers skip by means of the header length.
+    if (ret.headerLength < minimumLength || ret.totalImageSize < ret.headerLength) {
+        return ParseResultInvalid;
+    }
+
+    int optionalFieldsLength = 0;
+    if (ret.fieldControl & 0x01) {
+        optionalFieldsLength += 1;
+    }
+    if (ret.fieldControl & 0x02) {
+        optionalFieldsLength += 8;
+    }
+    if (ret.fieldControl & 0x04) {
+        optionalFieldsLength += 4;
+    }
+    if (minimumLength + optionalFieldsLength > ret.headerLength) {
+        return ParseResultInvalid;
+    }
+    if (length < minimumLength + optionalFieldsLength) {
+        return ParseResultIncomplete;
+    }
+
+    const char *optional = data + minimumLength;
+    if (ret.fieldControl & 0x01) {
+        ret.securityCredentialVersion = static_cast<quint8>(*optional);
+        optional += 1;
+    }
+    if (ret.fieldControl & 0x02) {
+        ret.upgradeFileDestination = qFromLittleEndian<quint64>(optional);
+        optional += 8;
+    }
+    if (ret.fieldControl & 0x04) {
+        ret.minimumHardwareVersion = qFromLittleEndian<quint16>(optional);
+        ret.maximumHardwareVersion = qFromLittleEndian<quint16>(optional + 2);
+    }
+
+    ret.headerString = QByteArray(raw->headerString, static_cast<int>(sizeof(raw->headerString)));
+    *header = ret;
+    return ParseResultOk;
+}
+
+int ZigbeeOtaImageHeader::find(const char *data, int length, ZigbeeOtaImageHeader *header, ParseResult *result)
+{
+    *result = ParseResultInvalid;
+    int pos = locate(data, length);
+    while (pos >= 0) {
+        *result = parse(data + pos, length - pos, header);
+        if (*result != ParseResultInvalid) {
+            return pos;
+        }
+        pos = locate(data, length, pos + 1);
+    }
+    return -1;
+}
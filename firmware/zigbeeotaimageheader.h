@@ -0,0 +1,75 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTAIMAGEHEADER_H
+#define ZIGBEEOTAIMAGEHEADER_H
+
+#include <QByteArray>
+
+// Zigbee OTA upgrade file header (ZCL OTA cluster specification, chapter 11.4)
+class ZigbeeOtaImageHeader
+{
+public:
+    static const quint32 fileIdentifier = 0x0BEEF11E;
+    static const int minimumLength = 56;
+
+    enum ParseResult {
+        ParseResultOk,
+        ParseResultIncomplete,
+        ParseResultInvalid
+    };
+
+    quint16 headerVersion = 0;
+    quint16 headerLength = 0;
+    quint16 fieldControl = 0;
+    quint16 manufacturerCode = 0;
+    quint16 imageType = 0;
+    quint32 fileVersion = 0;
+    quint16 zigbeeStackVersion = 0;
+    QByteArray headerString;
+    quint32 totalImageSize = 0;
+    quint8 securityCredentialVersion = 0;
+    quint64 upgradeFileDestination = 0;
+    quint16 minimumHardwareVersion = 0;
+    quint16 maximumHardwareVersion = 0;
+
+    // Returns the offset of the next OTA file identifier at or behind from, or -1
+    static int locate(const char *data, int length, int from = 0);
+
+    // Parses the header at the beginning of data, which must start with the file identifier
+    static ParseResult parse(const char *data, int length, ZigbeeOtaImageHeader *header);
+
+    // Searches data for a header, skipping vendor specific container data and false positives.
+    // Returns the offset of the header, or -1. The result tells if the header found is complete already.
+    static int find(const char *data, int length, ZigbeeOtaImageHeader *header, ParseResult *result);
+};
+
+#endif // ZIGBEEOTAIMAGEHEADER_H
@@ -0,0 +1,277 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotascheduler.h"
+#include "zigbeesharedregistry.h"
+
+#include <QRandomGenerator>
+
+// A running transfer which didn't request a block for this long gives up its slot
+static const int stallTimeout = 5 * 60 * 1000;
+
+// Clients usually time out and request the block again after a few seconds, never delay blocks longer than this
+static const int maximumBlockDelay = 2000;
+
+static ZigbeeSharedRegistry<ZigbeeOtaScheduler> &schedulers()
+{
+    static ZigbeeSharedRegistry<ZigbeeOtaScheduler> schedulers;
+    return schedulers;
+}
+
+ZigbeeOtaScheduler *ZigbeeOtaScheduler::acquire(QObject *subscriber)
+{
+    return schedulers().acquire(subscriber, [](){
+        return new ZigbeeOtaScheduler();
+    });
+}
+
+void ZigbeeOtaScheduler::release(QObject *subscriber)
+{
+    schedulers().release(this, subscriber);
+}
+
+ZigbeeOtaScheduler::ZigbeeOtaScheduler(QObject *parent):
+    QObject(parent)
+{
+    m_clock.start();
+
+    m_stallTimer.setInterval(60 * 1000);
+    connect(&m_stallTimer, &QTimer::timeout, this, &ZigbeeOtaScheduler::releaseStalledTransfers);
+
+    m_notifyTimer.setSingleShot(true);
+    connect(&m_notifyTimer, &QTimer::timeout, this, &ZigbeeOtaScheduler::processNotifyQueue);
+}
+
+int ZigbeeOtaScheduler::maximumTransfers() const
+{
+    return m_maximumTransfers;
+}
+
+void ZigbeeOtaScheduler::setMaximumTransfers(int maximumTransfers)
+{
+    m_maximumTransfers = qMax(1, maximumTransfers);
+    foreach (const QUuid &networkUuid, m_networks.keys()) {
+        admitQueued(networkUuid);
+    }
+}
+
+int ZigbeeOtaScheduler::blockInterval() const
+{
+    return m_blockInterval;
+}
+
+void ZigbeeOtaScheduler::setBlockInterval(int blockInterval)
+{
+    m_blockInterval = qMax(0, blockInterval);
+}
+
+bool ZigbeeOtaScheduler::requestTransfer(const QUuid &networkUuid, QObject *transfer)
+{
+    if (isActive(transfer)) {
+        return true;
+    }
+    if (isQueued(transfer)) {
+        return false;
+    }
+
+    Network &network = m_networks[networkUuid];
+    Transfer entry;
+    entry.networkUuid = networkUuid;
+    entry.lastActivity = m_clock.elapsed();
+    m_transfers.insert(transfer, entry);
+
+    connect(transfer, &QObject::destroyed, this, &ZigbeeOtaScheduler::objectDestroyed, Qt::UniqueConnection);
+
+    if (network.active.count() < m_maximumTransfers) {
+        network.active.append(transfer);
+        m_stallTimer.start();
+        return true;
+    }
+
+    network.queue.append(transfer);
+    return false;
+}
+
+void ZigbeeOtaScheduler::finishTransfer(QObject *transfer)
+{
+    if (!m_transfers.contains(transfer)) {
+        return;
+    }
+
+    QUuid networkUuid = m_transfers.take(transfer).networkUuid;
+    Network &network = m_networks[networkUuid];
+    network.queue.removeAll(transfer);
+    bool wasActive = network.active.removeAll(transfer) > 0;
+    if (network.active.isEmpty() && network.queue.isEmpty()) {
+        m_networks.remove(networkUuid);
+    }
+    if (m_networks.isEmpty()) {
+        m_stallTimer.stop();
+    }
+
+    if (wasActive) {
+        admitQueued(networkUuid);
+    }
+}
+
+bool ZigbeeOtaScheduler::isActive(QObject *transfer) const
+{
+    return m_transfers.contains(transfer) && m_networks.value(m_transfers.value(transfer).networkUuid).active.contains(transfer);
+}
+
+bool ZigbeeOtaScheduler::isQueued(QObject *transfer) const
+{
+    return m_transfers.contains(transfer) && m_networks.value(m_transfers.value(transfer).networkUuid).queue.contains(transfer);
+}
+
+int ZigbeeOtaScheduler::scheduleBlock(QObject *transfer, quint16 minimumBlockPeriod)
+{
+    if (!m_transfers.contains(transfer)) {
+        return 0;
+    }
+
+    qint64 now = m_clock.elapsed();
+    Transfer &entry = m_transfers[transfer];
+    Network &network = m_networks[entry.networkUuid];
+
+    // Keep the blocks of all transfers in a network apart from each other and honor the rate the client asked for
+    qint64 slot = qMax(now, qMax(network.nextBlock, entry.nextBlock));
+    slot = qMin(slot, now + maximumBlockDelay);
+
+    network.nextBlock = slot + m_blockInterval;
+    entry.nextBlock = slot + minimumBlockPeriod;
+    entry.lastActivity = now;
+    return static_cast<int>(slot - now);
+}
+
+int ZigbeeOtaScheduler::notifyWindow() const
+{
+    return m_notifyWindow;
+}
+
+void ZigbeeOtaScheduler::setNotifyWindow(int notifyWindow)
+{
+    m_notifyWindow = qMax(0, notifyWindow);
+}
+
+int ZigbeeOtaScheduler::notifyInterval() const
+{
+    return m_notifyInterval;
+}
+
+void ZigbeeOtaScheduler::setNotifyInterval(int notifyInterval)
+{
+    m_notifyInterval = qMax(0, notifyInterval);
+}
+
+void ZigbeeOtaScheduler::scheduleImageNotify(QObject *target)
+{
+    if (isImageNotifyScheduled(target)) {
+        return;
+    }
+
+    // Random jitter within the window spreads the notifies of all devices seen after a restart
+    qint64 due = m_clock.elapsed() + QRandomGenerator::global()->bounded(m_notifyWindow * 1000 + 1);
+    m_notifyQueue.insert(due, target);
+    m_notifyTimes.insert(target, due);
+    connect(target, &QObject::destroyed, this, &ZigbeeOtaScheduler::objectDestroyed, Qt::UniqueConnection);
+    processNotifyQueue();
+}
+
+bool ZigbeeOtaScheduler::isImageNotifyScheduled(QObject *target) const
+{
+    return m_notifyTimes.contains(target);
+}
+
+void ZigbeeOtaScheduler::objectDestroyed(QObject *object)
+{
+    finishTransfer(object);
+    if (m_notifyTimes.contains(object)) {
+        m_notifyQueue.remove(m_notifyTimes.take(object), object);
+    }
+}
+
+void ZigbeeOtaScheduler::processNotifyQueue()
+{
+    qint64 now = m_clock.elapsed();
+    if (!m_notifyQueue.isEmpty() && m_notifyQueue.firstKey() <= now && (m_lastNotify < 0 || now - m_lastNotify >= m_notifyInterval)) {
+        QObject *target = m_notifyQueue.take(m_notifyQueue.firstKey());
+        m_notifyTimes.remove(target);
+        m_lastNotify = now;
+        emit imageNotifyDue(target);
+    }
+
+    if (m_notifyQueue.isEmpty()) {
+        m_notifyTimer.stop();
+        return;
+    }
+
+    qint64 next = m_notifyQueue.firstKey();
+    if (m_lastNotify >= 0) {
+        next = qMax(next, m_lastNotify + m_notifyInterval);
+    }
+    m_notifyTimer.start(static_cast<int>(qMax<qint64>(0, next - m_clock.elapsed())));
+}
+
+void ZigbeeOtaScheduler::admitQueued(const QUuid &networkUuid)
+{
+    if (!m_networks.contains(networkUuid)) {
+        return;
+    }
+
+    QList<QObject*> admitted;
+    Network &network = m_networks[networkUuid];
+    while (!network.queue.isEmpty() && network.active.count() < m_maximumTransfers) {
+        QObject *transfer = network.queue.takeFirst();
+        network.active.append(transfer);
+        m_transfers[transfer].lastActivity = m_clock.elapsed();
+        admitted.append(transfer);
+    }
+
+    if (!admitted.isEmpty()) {
+        m_stallTimer.start();
+    }
+
+    // Emit after updating the state, receivers may call back into the scheduler
+    foreach (QObject *transfer, admitted) {
+        emit transferAdmitted(transfer);
+    }
+}
+
+void ZigbeeOtaScheduler::releaseStalledTransfers()
+{
+    qint64 now = m_clock.elapsed();
+    foreach (QObject *transfer, m_transfers.keys()) {
+        if (isActive(transfer) && now - m_transfers.value(transfer).lastActivity > stallTimeout) {
+            finishTransfer(transfer);
+        }
+    }
+}
@@ -0,0 +1,132 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEEOTASCHEDULER_H
+#define ZIGBEEOTASCHEDULER_H
+
+#include <QObject>
+#include <QUuid>
+#include <QHash>
+#include <QMultiMap>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Limits the number of concurrent OTA transfers per zigbee network and paces the image blocks
+// sent into a network. OTA transfers are very airtime intensive, running many of them in parallel
+// slows down regular traffic in the mesh. Image notify commands are spread over time as well, to
+// avoid a burst of notifies and image queries after a restart. The scheduler is shared by all zigbee
+// plugins in the process.
+class ZigbeeOtaScheduler: public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns the scheduler shared by all plugins, see ZigbeeSharedRegistry
+    static ZigbeeOtaScheduler *acquire(QObject *subscriber);
+    void release(QObject *subscriber);
+
+    // Number of transfers allowed to run at the same time in one network. Default is 1.
+    int maximumTransfers() const;
+    void setMaximumTransfers(int maximumTransfers);
+
+    // Minimum time between two image blocks sent into the same network, in milliseconds. Default is 50 ms.
+    int blockInterval() const;
+    void setBlockInterval(int blockInterval);
+
+    // Returns true if the transfer is running or may start now. Otherwise the transfer is queued
+    // and transferAdmitted() will be emitted once it may start.
+    bool requestTransfer(const QUuid &networkUuid, QObject *transfer);
+    void finishTransfer(QObject *transfer);
+
+    bool isActive(QObject *transfer) const;
+    bool isQueued(QObject *transfer) const;
+
+    // Reserves the send slot for the next block of a running transfer and returns the number of
+    // milliseconds to wait before sending it. minimumBlockPeriod is the one requested by the client.
+    int scheduleBlock(QObject *transfer, quint16 minimumBlockPeriod);
+
+    // Image notify commands are sent at a random time within this window, in seconds. Default is 10 minutes.
+    int notifyWindow() const;
+    void setNotifyWindow(int notifyWindow);
+
+    // Minimum time between two image notify commands, in milliseconds. Default is 2 seconds.
+    int notifyInterval() const;
+    void setNotifyInterval(int notifyInterval);
+
+    // Queues an image notify for the target. imageNotifyDue() is emitted when it should be sent.
+    void scheduleImageNotify(QObject *target);
+    bool isImageNotifyScheduled(QObject *target) const;
+
+signals:
+    void transferAdmitted(QObject *transfer);
+    void imageNotifyDue(QObject *target);
+
+private slots:
+    void objectDestroyed(QObject *object);
+
+private:
+    explicit ZigbeeOtaScheduler(QObject *parent = nullptr);
+
+    void admitQueued(const QUuid &networkUuid);
+    void releaseStalledTransfers();
+    void processNotifyQueue();
+
+    struct Network {
+        QList<QObject*> active;
+        QList<QObject*> queue;
+        qint64 nextBlock = 0;
+    };
+
+    struct Transfer {
+        QUuid networkUuid;
+        qint64 lastActivity = 0;
+        qint64 nextBlock = 0;
+    };
+
+    QHash<QUuid, Network> m_networks;
+    QHash<QObject*, Transfer> m_transfers;
+    int m_maximumTransfers = 1;
+    int m_blockInterval = 50;
+    QElapsedTimer m_clock;
+    QTimer m_stallTimer;
+
+    QMultiMap<qint64, QObject*> m_notifyQueue;
+    // Reverse index of the queue, looked up whenever a device is seen
+    QHash<QObject*, qint64> m_notifyTimes;
+    int m_notifyWindow = 10 * 60;
+    int m_notifyInterval = 2000;
+    qint64 m_lastNotify = -1;
+    QTimer m_notifyTimer;
+};
+
+#endif // ZIGBEEOTASCHEDULER_H
@@ -0,0 +1,106 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEESHAREDREGISTRY_H
+#define ZIGBEESHAREDREGISTRY_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+
+// Reference counted instances shared by all zigbee plugins, one per key. All plugins link this
+// library, so a registry defined in it exists exactly once per process, no matter how many plugins
+// are loaded. Every acquire() must be paired with a release(). Releasing the last subscriber
+// unregisters the instance right away and deletes it later, so acquiring the key again before the
+// deferred delete ran gets a new instance instead of the one about to be deleted.
+template <typename T, typename Key = int>
+class ZigbeeSharedRegistry
+{
+public:
+    // Returns the instance for the key, create() is called to construct it if there is none yet
+    template <typename Factory>
+    T *acquire(const Key &key, QObject *subscriber, Factory create)
+    {
+        Entry &entry = m_entries[key];
+        if (!entry.instance) {
+            entry.instance = create();
+        }
+        entry.subscribers.insert(subscriber);
+        return entry.instance;
+    }
+
+    // Returns true if this was the last subscriber and the instance is going to be deleted
+    bool release(const Key &key, T *instance, QObject *subscriber)
+    {
+        typename QHash<Key, Entry>::iterator it = m_entries.find(key);
+        if (it == m_entries.end() || it->instance != instance) {
+            return false;
+        }
+        it->subscribers.remove(subscriber);
+        if (!it->subscribers.isEmpty()) {
+            return false;
+        }
+        m_entries.erase(it);
+        instance->deleteLater();
+        return true;
+    }
+
+    // To be called when an instance is destroyed, it is only unregistered if it is still the registered one
+    void remove(const Key &key, T *instance)
+    {
+        typename QHash<Key, Entry>::iterator it = m_entries.find(key);
+        if (it != m_entries.end() && it->instance == instance) {
+            m_entries.erase(it);
+        }
+    }
+
+    QSet<QObject*> subscribers(const Key &key) const
+    {
+        return m_entries.value(key).subscribers;
+    }
+
+    // For instances shared without a key
+    template <typename Factory>
+    T *acquire(QObject *subscriber, Factory create) { return acquire(Key(), subscriber, create); }
+    bool release(T *instance, QObject *subscriber) { return release(Key(), instance, subscriber); }
+    void remove(T *instance) { remove(Key(), instance); }
+    QSet<QObject*> subscribers() const { return subscribers(Key()); }
+
+private:
+    struct Entry {
+        T *instance = nullptr;
+        QSet<QObject*> subscribers;
+    };
+
+    QHash<Key, Entry> m_entries;
+};
+
+#endif // ZIGBEESHAREDREGISTRY_H
@@ -43,10 +43,15 @@ isEmpty(WITH_PLUGINS) {
 }
 PLUGINS-=$${WITHOUT_PLUGINS}
 
+# Shared library linked by all plugins and its unit tests
+SUBDIRS += firmware tests
+tests.depends = firmware
+
 message("Building plugins:")
 for(plugin, PLUGINS) {
     exists($${plugin}) {
         SUBDIRS*= $${plugin}
+        $${plugin}.depends = firmware
         message("- $${plugin}")
     } else {
         error("Invalid plugin \"$${plugin}\".")
@@ -16,4 +16,8 @@ isEmpty(PLUGIN_PRI) {
   include($$PLUGIN_PRI)
 }
 
-QT += network
+QT += network concurrent
+
+# Services shared by all zigbee plugins, see firmware/firmware.pro
+INCLUDEPATH += $$PWD/firmware
+LIBS += -L$$OUT_PWD/../firmware -lnymea-plugins-zigbee-firmware
@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = testfirmwareindexreader
+
+SOURCES += \
+    testfirmwareindexreader.cpp \
+
@@ -0,0 +1,282 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareindexreader.h"
+
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+
+class TestFirmwareIndexReader: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readEntries();
+    void unescapeStrings();
+    void skipNestedValues();
+    void matchesJsonDocument();
+    void truncatedInput();
+    void invalidInput_data();
+    void invalidInput();
+
+    void benchmarkReader();
+    void benchmarkJsonDocument();
+
+private:
+    static QList<ZigbeeFirmwareIndexEntry> readIndex(const QByteArray &data, QString *errorString = nullptr);
+    static QList<ZigbeeFirmwareIndexEntry> readIndexWithJsonDocument(const QByteArray &data);
+    static QByteArray generateIndex(int count);
+};
+
+QList<ZigbeeFirmwareIndexEntry> TestFirmwareIndexReader::readIndex(const QByteArray &data, QString *errorString)
+{
+    // Same fields as ZigbeeIntegrationPlugin::firmwareIndexFromJson()
+    ZigbeeFirmwareIndexReader reader(data);
+    QList<ZigbeeFirmwareIndexEntry> ret = reader.read([](ZigbeeFirmwareIndexEntry *entry, const QLatin1String &key, const ZigbeeFirmwareIndexReader::Value &value){
+        if (key == QLatin1String("manufacturerCode")) {
+            entry->manufacturerCode = value.toUInt();
+        } else if (key == QLatin1String("imageType")) {
+            entry->imageType = value.toUInt();
+        } else if (key == QLatin1String("fileVersion")) {
+            entry->fileVersion = value.toUInt();
+        } else if (key == QLatin1String("minFileVersion")) {
+            entry->minFileVersion = value.toUInt();
+        } else if (key == QLatin1String("maxFileVersion")) {
+            entry->maxFileVersion = value.toUInt();
+        } else if (key == QLatin1String("fileSize")) {
+            entry->fileSize = value.toUInt();
+        } else if (key == QLatin1String("url")) {
+            entry->url = QUrl(value.toString());
+        } else if (key == QLatin1String("modelId")) {
+            entry->modelId = value.toString();
+        } else if (key == QLatin1String("sha512")) {
+            entry->sha512 = value.toByteArray();
+        }
+    });
+    if (errorString) {
+        *errorString = reader.errorString();
+    }
+    return ret;
+}
+
+QList<ZigbeeFirmwareIndexEntry> TestFirmwareIndexReader::readIndexWithJsonDocument(const QByteArray &data)
+{
+    // The way the index has been parsed before the streaming reader
+    QList<ZigbeeFirmwareIndexEntry> ret;
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError) {
+        return ret;
+    }
+    foreach (const QVariant &entryVariant, jsonDoc.toVariant().toList()) {
+        QVariantMap map = entryVariant.toMap();
+        ZigbeeFirmwareIndexEntry entry;
+        entry.manufacturerCode = map.value("manufacturerCode").toUInt();
+        entry.imageType = map.value("imageType").toUInt();
+        entry.fileVersion = map.value("fileVersion").toUInt();
+        entry.minFileVersion = map.value("minFileVersion").toUInt();
+        entry.maxFileVersion = map.value("maxFileVersion").toUInt();
+        entry.fileSize = map.value("fileSize").toUInt();
+        entry.url = map.value("url").toUrl();
+        entry.modelId = map.value("modelId").toString();
+        entry.sha512 = map.value("sha512").toByteArray();
+        ret.append(entry);
+    }
+    return ret;
+}
+
+QByteArray TestFirmwareIndexReader::generateIndex(int count)
+{
+    QJsonArray index;
+    for (int i = 0; i < count; i++) {
+        QJsonObject entry;
+        entry.insert("fileVersion", 0x01000000 + i);
+        entry.insert("fileSize", 150000 + i);
+        entry.insert("manufacturerCode", 4000 + (i % 50));
+        entry.insert("imageType", i % 300);
+        entry.insert("sha512", QString(QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha512).toHex()));
+        entry.insert("url", QString("https://example.com/images/vendor-%1/image_%2.ota").arg(i % 50).arg(i));
+        if (i % 3 == 0) {
+            entry.insert("modelId", QString("model/%1 \"rev\" é").arg(i));
+        }
+        if (i % 5 == 0) {
+            entry.insert("minFileVersion", i);
+            entry.insert("maxFileVersion", 0x01000000);
+        }
+        if (i % 7 == 0) {
+            entry.insert("path", QString("images/vendor\\%1").arg(i));
+            entry.insert("otaHeaderString", QString("Header\t%1").arg(i));
+            entry.insert("releaseNotes", QJsonArray() << "Fixes" << QJsonObject({{"nested", true}}));
+        }
+        index.append(entry);
+    }
+    return QJsonDocument(index).toJson(QJsonDocument::Compact);
+}
+
+void TestFirmwareIndexReader::readEntries()
+{
+    QByteArray data = "[\n"
+                      "  {\"fileVersion\": 16909060, \"fileSize\": 12345, \"manufacturerCode\": 4107, \"imageType\": 256,\n"
+                      "   \"sha512\": \"abcdef\", \"url\": \"https://example.com/a.ota\", \"modelId\": \"lumi.plug\",\n"
+                      "   \"minFileVersion\": 1, \"maxFileVersion\": \"2\", \"force\": true, \"notes\": null},\n"
+                      "  {\"fileVersion\": 1.0e3, \"manufacturerCode\": 4476, \"imageType\": 0}\n"
+                      "]";
+
+    QString errorString;
+    QList<ZigbeeFirmwareIndexEntry> entries = readIndex(data, &errorString);
+    QVERIFY2(errorString.isEmpty(), qPrintable(errorString));
+    QCOMPARE(entries.count(), 2);
+
+    QCOMPARE(entries.at(0).fileVersion, 16909060u);
+    QCOMPARE(entries.at(0).fileSize, 12345u);
+    QCOMPARE(entries.at(0).manufacturerCode, static_cast<quint16>(4107));
+    QCOMPARE(entries.at(0).imageType, static_cast<quint16>(256));
+    QCOMPARE(entries.at(0).sha512, QByteArray("abcdef"));
+    QCOMPARE(entries.at(0).url, QUrl("https://example.com/a.ota"));
+    QCOMPARE(entries.at(0).modelId, QString("lumi.plug"));
+    QCOMPARE(entries.at(0).minFileVersion, 1u);
+    QCOMPARE(entries.at(0).maxFileVersion, 2u);
+
+    QCOMPARE(entries.at(1).fileVersion, 1000u);
+    QCOMPARE(entries.at(1).manufacturerCode, static_cast<quint16>(4476));
+    QVERIFY(entries.at(1).modelId.isNull());
+
+    QCOMPARE(readIndex(" [ ] ").count(), 0);
+}
+
+void TestFirmwareIndexReader::unescapeStrings()
+{
+    QByteArray data = "[{\"modelId\": \"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\"}]";
+    QList<ZigbeeFirmwareIndexEntry> entries = readIndex(data);
+    QCOMPARE(entries.count(), 1);
+    QCOMPARE(entries.at(0).modelId, QString::fromUtf8("a\"b\\c/d\n\xc3\xa9\xf0\x9f\x98\x80"));
+}
+
+void TestFirmwareIndexReader::skipNestedValues()
+{
+    QByteArray data = "[{\"fileVersion\": 1, \"nested\": {\"fileVersion\": 2, \"list\": [1, \"]}\", {\"a\": []}]}, \"imageType\": 3},"
+                      " 42, \"ignored\", [1, 2],"
+                      " {\"fileVersion\": 4}]";
+    QString errorString;
+    QList<ZigbeeFirmwareIndexEntry> entries = readIndex(data, &errorString);
+    QVERIFY2(errorString.isEmpty(), qPrintable(errorString));
+    QCOMPARE(entries.count(), 2);
+    QCOMPARE(entries.at(0).fileVersion, 1u);
+    QCOMPARE(entries.at(0).imageType, static_cast<quint16>(3));
+    QCOMPARE(entries.at(1).fileVersion, 4u);
+}
+
+void TestFirmwareIndexReader::matchesJsonDocument()
+{
+    QByteArray data = generateIndex(500);
+    QList<ZigbeeFirmwareIndexEntry> expected = readIndexWithJsonDocument(data);
+    QList<ZigbeeFirmwareIndexEntry> entries = readIndex(data);
+    QCOMPARE(entries.count(), expected.count());
+    for (int i = 0; i < entries.count(); i++) {
+        QCOMPARE(entries.at(i).manufacturerCode, expected.at(i).manufacturerCode);
+        QCOMPARE(entries.at(i).imageType, expected.at(i).imageType);
+        QCOMPARE(entries.at(i).fileVersion, expected.at(i).fileVersion);
+        QCOMPARE(entries.at(i).minFileVersion, expected.at(i).minFileVersion);
+        QCOMPARE(entries.at(i).maxFileVersion, expected.at(i).maxFileVersion);
+        QCOMPARE(entries.at(i).fileSize, expected.at(i).fileSize);
+        QCOMPARE(entries.at(i).url, expected.at(i).url);
+        QCOMPARE(entries.at(i).modelId, expected.at(i).modelId);
+        QCOMPARE(entries.at(i).sha512, expected.at(i).sha512);
+    }
+}
+
+void TestFirmwareIndexReader::truncatedInput()
+{
+    // Every prefix of a valid index must be rejected without reading past the end of the data.
+    // The escapes make sure a prefix ends right behind a backslash.
+    QByteArray data = "[{\"modelId\": \"a\\\\b\\\"c\\u00e9\", \"fileVersion\": 1, \"nested\": [\"\\\\\", {\"x\": \"\\\"\"}]}]";
+    QVERIFY(!readIndex(data).isEmpty());
+
+    for (int length = 0; length < data.length(); length++) {
+        // Copy, so the data really ends at the given length instead of being a view into the full data
+        QByteArray truncated(data.constData(), length);
+        QString errorString;
+        QList<ZigbeeFirmwareIndexEntry> entries = readIndex(truncated, &errorString);
+        QVERIFY2(entries.isEmpty(), qPrintable(QString("Prefix of length %1 accepted").arg(length)));
+        QVERIFY2(!errorString.isEmpty(), qPrintable(QString("No error for prefix of length %1").arg(length)));
+    }
+}
+
+void TestFirmwareIndexReader::invalidInput_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("object") << QByteArray("{\"fileVersion\": 1}");
+    QTest::newRow("trailing backslash") << QByteArray("[{\"url\": \"abc\\");
+    QTest::newRow("unterminated string") << QByteArray("[{\"url\": \"abc}]");
+    QTest::newRow("missing colon") << QByteArray("[{\"url\" \"abc\"}]");
+    QTest::newRow("missing comma") << QByteArray("[{\"a\": 1 \"b\": 2}]");
+    QTest::newRow("invalid literal") << QByteArray("[{\"a\": nope}]");
+    QTest::newRow("unterminated array") << QByteArray("[{\"a\": 1},");
+    QTest::newRow("unterminated nested") << QByteArray("[{\"a\": [1, {\"b\": 2}");
+}
+
+void TestFirmwareIndexReader::invalidInput()
+{
+    QFETCH(QByteArray, data);
+
+    QString errorString;
+    QList<ZigbeeFirmwareIndexEntry> entries = readIndex(data, &errorString);
+    QVERIFY(entries.isEmpty());
+    QVERIFY(!errorString.isEmpty());
+}
+
+void TestFirmwareIndexReader::benchmarkReader()
+{
+    QByteArray data = generateIndex(5000);
+    int count = 0;
+    QBENCHMARK {
+        count = readIndex(data).count();
+    }
+    QCOMPARE(count, 5000);
+}
+
+void TestFirmwareIndexReader::benchmarkJsonDocument()
+{
+    QByteArray data = generateIndex(5000);
+    int count = 0;
+    QBENCHMARK {
+        count = readIndexWithJsonDocument(data).count();
+    }
+    QCOMPARE(count, 5000);
+}
+
+QTEST_GUILESS_MAIN(TestFirmwareIndexReader)
+#include "testfirmwareindexreader.moc"
@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = testfirmwareindexservice
+
+SOURCES += \
+    testfirmwareindexservice.cpp \
+
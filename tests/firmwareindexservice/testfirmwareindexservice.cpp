@@ -0,0 +1,291 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeefirmwareindexservice.h"
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <QNetworkProxy>
+#include <QNetworkReply>
+#include <QStandardPaths>
+
+// Minimal HTTP server answering every request with the next queued response and closing the connection
+class HttpStandIn: public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    struct Request {
+        QByteArray path;
+        QHash<QByteArray, QByteArray> headers;
+    };
+
+    struct Response {
+        int status;
+        QByteArray body;
+        QList<QPair<QByteArray, QByteArray>> headers;
+    };
+
+    explicit HttpStandIn(QObject *parent = nullptr):
+        QTcpServer(parent)
+    {
+        connect(this, &QTcpServer::newConnection, this, [this](){
+            while (hasPendingConnections()) {
+                QTcpSocket *socket = nextPendingConnection();
+                connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+                connect(socket, &QTcpSocket::readyRead, this, [this, socket](){
+                    m_buffers[socket].append(socket->readAll());
+                    if (m_buffers.value(socket).contains("\r\n\r\n")) {
+                        handleRequest(socket, m_buffers.take(socket));
+                    }
+                });
+            }
+        });
+    }
+
+    void queueResponse(int status, const QByteArray &body = QByteArray(), const QList<QPair<QByteArray, QByteArray>> &headers = QList<QPair<QByteArray, QByteArray>>())
+    {
+        Response response;
+        response.status = status;
+        response.body = body;
+        response.headers = headers;
+        responses.append(response);
+    }
+
+    QList<Request> requests;
+    QList<Response> responses;
+
+private:
+    void handleRequest(QTcpSocket *socket, const QByteArray &data)
+    {
+        QList<QByteArray> lines = data.left(data.indexOf("\r\n\r\n")).split('\n');
+        Request request;
+        request.path = lines.takeFirst().split(' ').value(1);
+        foreach (const QByteArray &line, lines) {
+            int colon = line.indexOf(':');
+            request.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+        requests.append(request);
+
+        // Nothing queued, behave like a broken server
+        Response response;
+        response.status = 500;
+        if (!responses.isEmpty()) {
+            response = responses.takeFirst();
+        }
+        QByteArray reply = "HTTP/1.1 " + QByteArray::number(response.status) + " Status\r\n";
+        reply += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+        reply += "Connection: close\r\n";
+        for (int i = 0; i < response.headers.count(); i++) {
+            reply += response.headers.at(i).first + ": " + response.headers.at(i).second + "\r\n";
+        }
+        reply += "\r\n" + response.body;
+        socket->write(reply);
+        socket->disconnectFromHost();
+    }
+
+    QHash<QTcpSocket*, QByteArray> m_buffers;
+};
+
+class TestFirmwareIndexService: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void fetchAndRevalidate();
+    void backoffAfterServerErrors();
+    void sharedPerUrl();
+
+private:
+    QUrl indexUrl(const QString &path) const;
+    ZigbeeFirmwareIndexService *acquire(const QUrl &url);
+    static qint64 secondsUntil(const QDateTime &dateTime);
+
+    HttpStandIn m_server;
+    QNetworkAccessManager m_networkManager;
+    ZigbeeFirmwareIndexService::Fetcher m_fetcher;
+    QList<ZigbeeFirmwareIndexService*> m_services;
+};
+
+void TestFirmwareIndexService::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_server.listen(QHostAddress::LocalHost));
+    m_networkManager.setProxy(QNetworkProxy::NoProxy);
+    m_fetcher = [this](const QNetworkRequest &request){
+        return m_networkManager.get(request);
+    };
+}
+
+void TestFirmwareIndexService::init()
+{
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/zigbee-firmwares").removeRecursively();
+    m_server.requests.clear();
+    m_server.responses.clear();
+}
+
+void TestFirmwareIndexService::cleanup()
+{
+    foreach (ZigbeeFirmwareIndexService *service, m_services) {
+        service->release(this);
+    }
+    m_services.clear();
+    // Process the deferred deletes so the next test starts with fresh services
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+QUrl TestFirmwareIndexService::indexUrl(const QString &path) const
+{
+    return QUrl(QString("http://127.0.0.1:%1/%2").arg(m_server.serverPort()).arg(path));
+}
+
+ZigbeeFirmwareIndexService *TestFirmwareIndexService::acquire(const QUrl &url)
+{
+    // One entry per line, holding the file version
+    ZigbeeFirmwareIndexService *service = ZigbeeFirmwareIndexService::acquire(url, this, [](const QByteArray &data){
+        QList<ZigbeeFirmwareIndexEntry> entries;
+        foreach (const QByteArray &line, data.split('\n')) {
+            if (!line.isEmpty()) {
+                ZigbeeFirmwareIndexEntry entry;
+                entry.fileVersion = line.toUInt();
+                entries.append(entry);
+            }
+        }
+        return entries;
+    });
+    m_services.append(service);
+    return service;
+}
+
+qint64 TestFirmwareIndexService::secondsUntil(const QDateTime &dateTime)
+{
+    return QDateTime::currentDateTime().secsTo(dateTime);
+}
+
+void TestFirmwareIndexService::fetchAndRevalidate()
+{
+    QByteArray entityTag = "\"v1\"";
+    QByteArray lastModified = "Wed, 21 Oct 2015 07:28:00 GMT";
+    m_server.queueResponse(200, "1\n2\n", {qMakePair(QByteArray("ETag"), entityTag), qMakePair(QByteArray("Last-Modified"), lastModified)});
+
+    ZigbeeFirmwareIndexService *service = acquire(indexUrl("revalidate.json"));
+    QSignalSpy catalogSpy(service, &ZigbeeFirmwareIndexService::catalogChanged);
+    service->update(m_fetcher);
+
+    QTRY_COMPARE(catalogSpy.count(), 1);
+    QCOMPARE(service->catalog()->count(), 2);
+    QCOMPARE(m_server.requests.count(), 1);
+    QCOMPARE(m_server.requests.at(0).path, QByteArray("/revalidate.json"));
+    // Nothing cached yet, so the request must be unconditional
+    QVERIFY(!m_server.requests.at(0).headers.contains("if-none-match"));
+    QVERIFY(!m_server.requests.at(0).headers.contains("if-modified-since"));
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - service->refreshInterval()) <= 2);
+
+    // The next refresh revalidates the cached index and keeps it when not modified
+    QDateTime firstUpdate = service->lastUpdate();
+    m_server.queueResponse(304);
+    service->setRefreshInterval(1);
+
+    QTRY_COMPARE(m_server.requests.count(), 2);
+    QCOMPARE(m_server.requests.at(1).headers.value("if-none-match"), entityTag);
+    QCOMPARE(m_server.requests.at(1).headers.value("if-modified-since"), lastModified);
+    QTRY_VERIFY(service->lastUpdate() > firstUpdate);
+    QCOMPARE(catalogSpy.count(), 1);
+    QCOMPARE(service->catalog()->count(), 2);
+}
+
+void TestFirmwareIndexService::backoffAfterServerErrors()
+{
+    m_server.queueResponse(503);
+    m_server.queueResponse(500);
+    m_server.queueResponse(502);
+    m_server.queueResponse(200, "7\n");
+
+    ZigbeeFirmwareIndexService *service = acquire(indexUrl("backoff.json"));
+    QSignalSpy catalogSpy(service, &ZigbeeFirmwareIndexService::catalogChanged);
+
+    // Without any index update() fetches right away, which lets the test step through the retries
+    service->update(m_fetcher);
+    QTRY_VERIFY(service->nextUpdate().isValid());
+    QCOMPARE(m_server.requests.count(), 1);
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - 5 * 60) <= 2);
+
+    service->update(m_fetcher);
+    QVERIFY(!service->nextUpdate().isValid());
+    QTRY_VERIFY(service->nextUpdate().isValid());
+    QCOMPARE(m_server.requests.count(), 2);
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - 10 * 60) <= 2);
+
+    // Retries never wait longer than a regular refresh. Changing the interval must not cut the backoff short.
+    service->setRefreshInterval(15 * 60);
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - 10 * 60) <= 2);
+    service->update(m_fetcher);
+    QTRY_VERIFY(service->nextUpdate().isValid());
+    QCOMPARE(m_server.requests.count(), 3);
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - 15 * 60) <= 2);
+    QCOMPARE(catalogSpy.count(), 0);
+    QVERIFY(service->catalog()->isEmpty());
+
+    service->update(m_fetcher);
+    QTRY_COMPARE(catalogSpy.count(), 1);
+    QCOMPARE(m_server.requests.count(), 4);
+    QCOMPARE(service->catalog()->count(), 1);
+    QVERIFY(qAbs(secondsUntil(service->nextUpdate()) - 15 * 60) <= 2);
+}
+
+void TestFirmwareIndexService::sharedPerUrl()
+{
+    QObject otherSubscriber;
+    ZigbeeFirmwareIndexService *first = acquire(indexUrl("shared.json"));
+    ZigbeeFirmwareIndexService *second = ZigbeeFirmwareIndexService::acquire(indexUrl("shared.json"), &otherSubscriber, [](const QByteArray &){
+        return QList<ZigbeeFirmwareIndexEntry>();
+    });
+    QCOMPARE(second, first);
+    QVERIFY(acquire(indexUrl("other.json")) != first);
+
+    // The parser of the oldest subscriber is used
+    m_server.queueResponse(200, "1\n");
+    first->update(m_fetcher);
+    QTRY_COMPARE(first->catalog()->count(), 1);
+
+    // The service stays as long as anyone uses it
+    second->release(&otherSubscriber);
+    QCOMPARE(acquire(indexUrl("shared.json")), first);
+}
+
+QTEST_GUILESS_MAIN(TestFirmwareIndexService)
+#include "testfirmwareindexservice.moc"
@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+TARGET = testlumimodelmatcher
+
+# The matcher is part of the Lumi plugin, it is built into the test directly
+INCLUDEPATH += $$PWD/../../zigbeelumi
+
+SOURCES += \
+    testlumimodelmatcher.cpp \
+    ../../zigbeelumi/zigbeelumimodelmatcher.cpp \
+
+HEADERS += \
+    ../../zigbeelumi/zigbeelumimodelmatcher.h \
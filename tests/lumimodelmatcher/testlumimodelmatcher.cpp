@@ -0,0 +1,239 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeelumimodelmatcher.h"
+
+#include <QtTest>
+#include <QRandomGenerator>
+
+Q_DECLARE_METATYPE(ZigbeeLumiModelMatcher::Model)
+
+class TestLumiModelMatcher: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchPrefixes_data();
+    void matchPrefixes();
+    void matchRemotes_data();
+    void matchRemotes();
+    void matchMotionSensors_data();
+    void matchMotionSensors();
+    void rejectUnknownIdentifiers_data();
+    void rejectUnknownIdentifiers();
+    void matchesLinearSearch();
+
+    void benchmarkMatch_data();
+    void benchmarkMatch();
+
+private:
+    static QList<QPair<QString, ZigbeeLumiModelMatcher::Model>> knownPrefixes();
+    static ZigbeeLumiModelMatcher::Model linearSearch(const QString &modelIdentifier);
+};
+
+QList<QPair<QString, ZigbeeLumiModelMatcher::Model>> TestLumiModelMatcher::knownPrefixes()
+{
+    return {
+        {"lumi.sensor_ht", ZigbeeLumiModelMatcher::ModelHTSensor},
+        {"lumi.sensor_magnet", ZigbeeLumiModelMatcher::ModelMagnetSensor},
+        {"lumi.sensor_switch", ZigbeeLumiModelMatcher::ModelButtonSensor},
+        {"lumi.sensor_motion", ZigbeeLumiModelMatcher::ModelAqaraMotionSensor},
+        {"lumi.sensor_wleak", ZigbeeLumiModelMatcher::ModelWaterSensor},
+        {"lumi.weather", ZigbeeLumiModelMatcher::ModelWeatherSensor},
+        {"lumi.vibration", ZigbeeLumiModelMatcher::ModelVibrationSensor},
+        {"lumi.plug", ZigbeeLumiModelMatcher::ModelPowerSocket},
+        {"lumi.relay", ZigbeeLumiModelMatcher::ModelRelay},
+        {"lumi.remote", ZigbeeLumiModelMatcher::ModelRemote},
+        {"lumi.remote.b1acn01", ZigbeeLumiModelMatcher::ModelLongpressButtonSensor}
+    };
+}
+
+// Longest matching prefix by comparing against every known prefix
+ZigbeeLumiModelMatcher::Model TestLumiModelMatcher::linearSearch(const QString &modelIdentifier)
+{
+    ZigbeeLumiModelMatcher::Model model = ZigbeeLumiModelMatcher::ModelUnknown;
+    int length = -1;
+    typedef QPair<QString, ZigbeeLumiModelMatcher::Model> Prefix;
+    foreach (const Prefix &prefix, knownPrefixes()) {
+        if (modelIdentifier.startsWith(prefix.first) && prefix.first.length() > length) {
+            model = prefix.second;
+            length = prefix.first.length();
+        }
+    }
+    return model;
+}
+
+void TestLumiModelMatcher::matchPrefixes_data()
+{
+    QTest::addColumn<QString>("modelIdentifier");
+    QTest::addColumn<ZigbeeLumiModelMatcher::Model>("model");
+
+    typedef QPair<QString, ZigbeeLumiModelMatcher::Model> Prefix;
+    foreach (const Prefix &prefix, knownPrefixes()) {
+        QTest::newRow(qUtf8Printable(prefix.first)) << prefix.first << prefix.second;
+    }
+    QTest::newRow("lumi.sensor_ht.agl02") << "lumi.sensor_ht.agl02" << ZigbeeLumiModelMatcher::ModelHTSensor;
+    QTest::newRow("lumi.sensor_magnet.aq2") << "lumi.sensor_magnet.aq2" << ZigbeeLumiModelMatcher::ModelMagnetSensor;
+    QTest::newRow("lumi.sensor_switch.aq3") << "lumi.sensor_switch.aq3" << ZigbeeLumiModelMatcher::ModelButtonSensor;
+    QTest::newRow("lumi.sensor_wleak.aq1") << "lumi.sensor_wleak.aq1" << ZigbeeLumiModelMatcher::ModelWaterSensor;
+    QTest::newRow("lumi.weather.v1") << "lumi.weather.v1" << ZigbeeLumiModelMatcher::ModelWeatherSensor;
+    QTest::newRow("lumi.vibration.aq1") << "lumi.vibration.aq1" << ZigbeeLumiModelMatcher::ModelVibrationSensor;
+    QTest::newRow("lumi.plug.maeu01") << "lumi.plug.maeu01" << ZigbeeLumiModelMatcher::ModelPowerSocket;
+    QTest::newRow("lumi.plug.mmeu01") << "lumi.plug.mmeu01" << ZigbeeLumiModelMatcher::ModelPowerSocket;
+    QTest::newRow("lumi.relay.c2acn01") << "lumi.relay.c2acn01" << ZigbeeLumiModelMatcher::ModelRelay;
+}
+
+void TestLumiModelMatcher::matchPrefixes()
+{
+    QFETCH(QString, modelIdentifier);
+    QFETCH(ZigbeeLumiModelMatcher::Model, model);
+
+    ZigbeeLumiModelMatcher matcher;
+    QCOMPARE(matcher.match(modelIdentifier, true), model);
+    if (model != ZigbeeLumiModelMatcher::ModelAqaraMotionSensor) {
+        // The illuminance cluster only matters for motion sensors
+        QCOMPARE(matcher.match(modelIdentifier, false), model);
+    }
+}
+
+void TestLumiModelMatcher::matchRemotes_data()
+{
+    QTest::addColumn<QString>("modelIdentifier");
+    QTest::addColumn<ZigbeeLumiModelMatcher::Model>("model");
+
+    QTest::newRow("family") << "lumi.remote" << ZigbeeLumiModelMatcher::ModelRemote;
+    QTest::newRow("longpress button") << "lumi.remote.b1acn01" << ZigbeeLumiModelMatcher::ModelLongpressButtonSensor;
+    QTest::newRow("longpress button revision") << "lumi.remote.b1acn01.v2" << ZigbeeLumiModelMatcher::ModelLongpressButtonSensor;
+    QTest::newRow("other remote") << "lumi.remote.b286acn01" << ZigbeeLumiModelMatcher::ModelRemote;
+    QTest::newRow("shorter than longpress button") << "lumi.remote.b1acn0" << ZigbeeLumiModelMatcher::ModelRemote;
+    QTest::newRow("diverging from longpress button") << "lumi.remote.b1acn02" << ZigbeeLumiModelMatcher::ModelRemote;
+    QTest::newRow("dot only") << "lumi.remote." << ZigbeeLumiModelMatcher::ModelRemote;
+}
+
+void TestLumiModelMatcher::matchRemotes()
+{
+    QFETCH(QString, modelIdentifier);
+    QFETCH(ZigbeeLumiModelMatcher::Model, model);
+
+    ZigbeeLumiModelMatcher matcher;
+    QCOMPARE(matcher.match(modelIdentifier, false), model);
+}
+
+void TestLumiModelMatcher::matchMotionSensors_data()
+{
+    QTest::addColumn<QString>("modelIdentifier");
+    QTest::addColumn<bool>("hasIlluminanceMeasurement");
+    QTest::addColumn<ZigbeeLumiModelMatcher::Model>("model");
+
+    QTest::newRow("xiaomi") << "lumi.sensor_motion" << false << ZigbeeLumiModelMatcher::ModelXiaomiMotionSensor;
+    QTest::newRow("xiaomi with illuminance") << "lumi.sensor_motion" << true << ZigbeeLumiModelMatcher::ModelAqaraMotionSensor;
+    QTest::newRow("aqara") << "lumi.sensor_motion.aq2" << true << ZigbeeLumiModelMatcher::ModelAqaraMotionSensor;
+    QTest::newRow("aqara without illuminance") << "lumi.sensor_motion.aq2" << false << ZigbeeLumiModelMatcher::ModelXiaomiMotionSensor;
+    QTest::newRow("truncated") << "lumi.sensor_motio" << true << ZigbeeLumiModelMatcher::ModelUnknown;
+}
+
+void TestLumiModelMatcher::matchMotionSensors()
+{
+    QFETCH(QString, modelIdentifier);
+    QFETCH(bool, hasIlluminanceMeasurement);
+    QFETCH(ZigbeeLumiModelMatcher::Model, model);
+
+    ZigbeeLumiModelMatcher matcher;
+    QCOMPARE(matcher.match(modelIdentifier, hasIlluminanceMeasurement), model);
+}
+
+void TestLumiModelMatcher::rejectUnknownIdentifiers_data()
+{
+    QTest::addColumn<QString>("modelIdentifier");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("vendor only") << "lumi";
+    QTest::newRow("vendor and dot") << "lumi.";
+    QTest::newRow("shared part of prefixes") << "lumi.sensor_";
+    QTest::newRow("truncated prefix") << "lumi.plu";
+    QTest::newRow("unknown model") << "lumi.light.aqcn02";
+    QTest::newRow("case differs") << "Lumi.plug";
+    QTest::newRow("other vendor") << "xiaomi.plug";
+    QTest::newRow("prefix inside") << "x.lumi.plug";
+}
+
+void TestLumiModelMatcher::rejectUnknownIdentifiers()
+{
+    QFETCH(QString, modelIdentifier);
+
+    ZigbeeLumiModelMatcher matcher;
+    QCOMPARE(matcher.match(modelIdentifier, true), ZigbeeLumiModelMatcher::ModelUnknown);
+    QCOMPARE(matcher.match(modelIdentifier, false), ZigbeeLumiModelMatcher::ModelUnknown);
+}
+
+void TestLumiModelMatcher::matchesLinearSearch()
+{
+    // Fixed seed, failures must be reproducible
+    QRandomGenerator random(25);
+    const QString characters = "lumi._sensorhtagpwbc0123";
+    QList<QPair<QString, ZigbeeLumiModelMatcher::Model>> prefixes = knownPrefixes();
+
+    ZigbeeLumiModelMatcher matcher;
+    for (int i = 0; i < 10000; i++) {
+        // Truncate a known prefix and append random characters
+        QString modelIdentifier = prefixes.at(random.bounded(prefixes.count())).first;
+        modelIdentifier.truncate(random.bounded(modelIdentifier.length() + 1));
+        int suffixLength = random.bounded(8);
+        for (int j = 0; j < suffixLength; j++) {
+            modelIdentifier.append(characters.at(random.bounded(characters.length())));
+        }
+        QCOMPARE(matcher.match(modelIdentifier, true), linearSearch(modelIdentifier));
+    }
+}
+
+void TestLumiModelMatcher::benchmarkMatch_data()
+{
+    QTest::addColumn<QString>("modelIdentifier");
+
+    QTest::newRow("known") << "lumi.remote.b1acn01";
+    QTest::newRow("unknown") << "lumi.light.aqcn02";
+    QTest::newRow("long unknown") << QString("lumi.sensor_").append(QString(1000, 'x'));
+}
+
+void TestLumiModelMatcher::benchmarkMatch()
+{
+    QFETCH(QString, modelIdentifier);
+
+    ZigbeeLumiModelMatcher matcher;
+    ZigbeeLumiModelMatcher::Model model = ZigbeeLumiModelMatcher::ModelUnknown;
+    QBENCHMARK {
+        model = matcher.match(modelIdentifier, true);
+    }
+    Q_UNUSED(model)
+}
+
+QTEST_GUILESS_MAIN(TestLumiModelMatcher)
+#include "testlumimodelmatcher.moc"
@@ -0,0 +1,7 @@
+include(../tests.pri)
+
+TARGET = testotaimageheader
+
+SOURCES += \
+    testotaimageheader.cpp \
+
@@ -0,0 +1,280 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeeotaimageheader.h"
+
+#include <QtTest>
+#include <QtEndian>
+#include <QRandomGenerator>
+
+class TestOtaImageHeader: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseHeader();
+    void parseOptionalFields();
+    void acceptLongHeaders();
+    void rejectInvalidHeaders_data();
+    void rejectInvalidHeaders();
+    void findBehindContainerData();
+    void incompleteHeader();
+
+    void fuzzRandomData();
+    void fuzzMutatedHeaders();
+
+    void benchmarkParse();
+    void benchmarkFind();
+
+private:
+    static QByteArray buildHeader(quint16 headerLength, quint32 totalImageSize, quint16 fieldControl = 0);
+    static void verifyConsistent(const QByteArray &data, int offset, ZigbeeOtaImageHeader::ParseResult result, const ZigbeeOtaImageHeader &header);
+};
+
+QByteArray TestOtaImageHeader::buildHeader(quint16 headerLength, quint32 totalImageSize, quint16 fieldControl)
+{
+    QByteArray header(headerLength, '\0');
+    char *data = header.data();
+    qToLittleEndian<quint32>(ZigbeeOtaImageHeader::fileIdentifier, data);
+    qToLittleEndian<quint16>(0x0100, data + 4);
+    qToLittleEndian<quint16>(headerLength, data + 6);
+    qToLittleEndian<quint16>(fieldControl, data + 8);
+    qToLittleEndian<quint16>(0x115f, data + 10);
+    qToLittleEndian<quint16>(0x2001, data + 12);
+    qToLittleEndian<quint32>(0x00000017, data + 14);
+    qToLittleEndian<quint16>(0x0002, data + 18);
+    memcpy(data + 20, "lumi.plug", 9);
+    qToLittleEndian<quint32>(totalImageSize, data + 52);
+
+    char *optional = data + ZigbeeOtaImageHeader::minimumLength;
+    if (fieldControl & 0x01) {
+        *optional = 0x02;
+        optional += 1;
+    }
+    if (fieldControl & 0x02) {
+        qToLittleEndian<quint64>(Q_UINT64_C(0x00124b0012345678), optional);
+        optional += 8;
+    }
+    if (fieldControl & 0x04) {
+        qToLittleEndian<quint16>(1, optional);
+        qToLittleEndian<quint16>(3, optional + 2);
+    }
+    return header;
+}
+
+void TestOtaImageHeader::verifyConsistent(const QByteArray &data, int offset, ZigbeeOtaImageHeader::ParseResult result, const ZigbeeOtaImageHeader &header)
+{
+    if (offset < 0) {
+        QCOMPARE(result, ZigbeeOtaImageHeader::ParseResultInvalid);
+        return;
+    }
+    QVERIFY(offset + 4 <= data.size());
+    QCOMPARE(qFromLittleEndian<quint32>(data.constData() + offset), quint32(ZigbeeOtaImageHeader::fileIdentifier));
+    if (result == ZigbeeOtaImageHeader::ParseResultOk) {
+        QVERIFY(header.headerLength >= ZigbeeOtaImageHeader::minimumLength);
+        QVERIFY(header.totalImageSize >= header.headerLength);
+        QCOMPARE(header.headerString.size(), 32);
+    }
+}
+
+void TestOtaImageHeader::parseHeader()
+{
+    QByteArray data = buildHeader(56, 1000);
+    ZigbeeOtaImageHeader header;
+    QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header), ZigbeeOtaImageHeader::ParseResultOk);
+    QCOMPARE(header.headerVersion, static_cast<quint16>(0x0100));
+    QCOMPARE(header.headerLength, static_cast<quint16>(56));
+    QCOMPARE(header.manufacturerCode, static_cast<quint16>(0x115f));
+    QCOMPARE(header.imageType, static_cast<quint16>(0x2001));
+    QCOMPARE(header.fileVersion, static_cast<quint32>(0x17));
+    QCOMPARE(header.zigbeeStackVersion, static_cast<quint16>(2));
+    QCOMPARE(header.totalImageSize, static_cast<quint32>(1000));
+    QVERIFY(header.headerString.startsWith("lumi.plug"));
+}
+
+void TestOtaImageHeader::parseOptionalFields()
+{
+    QByteArray data = buildHeader(69, 1000, 0x07);
+    ZigbeeOtaImageHeader header;
+    QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header), ZigbeeOtaImageHeader::ParseResultOk);
+    QCOMPARE(header.securityCredentialVersion, static_cast<quint8>(2));
+    QCOMPARE(header.upgradeFileDestination, Q_UINT64_C(0x00124b0012345678));
+    QCOMPARE(header.minimumHardwareVersion, static_cast<quint16>(1));
+    QCOMPARE(header.maximumHardwareVersion, static_cast<quint16>(3));
+}
+
+void TestOtaImageHeader::acceptLongHeaders()
+{
+    // Fields added by later revisions of the specification are skipped by means of the header length
+    QByteArray data = buildHeader(120, 4096, 0x04);
+    ZigbeeOtaImageHeader header;
+    QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header), ZigbeeOtaImageHeader::ParseResultOk);
+    QCOMPARE(header.headerLength, static_cast<quint16>(120));
+    QCOMPARE(header.maximumHardwareVersion, static_cast<quint16>(3));
+
+    data = buildHeader(0xffff, 0x10000);
+    QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header), ZigbeeOtaImageHeader::ParseResultOk);
+    QCOMPARE(header.headerLength, static_cast<quint16>(0xffff));
+}
+
+void TestOtaImageHeader::rejectInvalidHeaders_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QByteArray wrongIdentifier = buildHeader(56, 1000);
+    wrongIdentifier[0] = 0x1f;
+    QTest::newRow("identifier") << wrongIdentifier;
+
+    QByteArray shortHeader = buildHeader(56, 1000);
+    qToLittleEndian<quint16>(55, shortHeader.data() + 6);
+    QTest::newRow("header length below minimum") << shortHeader;
+
+    QTest::newRow("image smaller than header") << buildHeader(100, 99);
+
+    QByteArray optionalFields = buildHeader(60, 1000, 0x02);
+    QTest::newRow("optional fields exceed header length") << optionalFields;
+}
+
+void TestOtaImageHeader::rejectInvalidHeaders()
+{
+    QFETCH(QByteArray, data);
+
+    ZigbeeOtaImageHeader header;
+    QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header), ZigbeeOtaImageHeader::ParseResultInvalid);
+}
+
+void TestOtaImageHeader::findBehindContainerData()
+{
+    // Vendor container with a false identifier match in front of the actual image
+    QByteArray data(200, '\0');
+    qToLittleEndian<quint32>(ZigbeeOtaImageHeader::fileIdentifier, data.data() + 17);
+    data.append(buildHeader(64, 1000));
+
+    ZigbeeOtaImageHeader header;
+    ZigbeeOtaImageHeader::ParseResult result;
+    QCOMPARE(ZigbeeOtaImageHeader::find(data.constData(), data.size(), &header, &result), 200);
+    QCOMPARE(result, ZigbeeOtaImageHeader::ParseResultOk);
+    QCOMPARE(header.headerLength, static_cast<quint16>(64));
+
+    QCOMPARE(ZigbeeOtaImageHeader::find(data.constData(), 150, &header, &result), -1);
+    QCOMPARE(result, ZigbeeOtaImageHeader::ParseResultInvalid);
+}
+
+void TestOtaImageHeader::incompleteHeader()
+{
+    QByteArray data = buildHeader(69, 1000, 0x07);
+    ZigbeeOtaImageHeader header;
+    for (int length = 4; length < 69; length++) {
+        QCOMPARE(ZigbeeOtaImageHeader::parse(data.constData(), length, &header), ZigbeeOtaImageHeader::ParseResultIncomplete);
+    }
+}
+
+void TestOtaImageHeader::fuzzRandomData()
+{
+    // Fixed seed, failures must be reproducible
+    QRandomGenerator generator(0x5a494742);
+    for (int round = 0; round < 2000; round++) {
+        QByteArray data(static_cast<int>(generator.bounded(512)), '\0');
+        for (int i = 0; i < data.size(); i++) {
+            data[i] = static_cast<char>(generator.bounded(256));
+        }
+        // Plant identifiers so the parser gets to look at the random bytes behind them
+        int identifiers = generator.bounded(4);
+        for (int i = 0; i < identifiers && data.size() >= 4; i++) {
+            qToLittleEndian<quint32>(ZigbeeOtaImageHeader::fileIdentifier, data.data() + generator.bounded(data.size() - 3));
+        }
+
+        ZigbeeOtaImageHeader header;
+        ZigbeeOtaImageHeader::ParseResult result;
+        int offset = ZigbeeOtaImageHeader::find(data.constData(), data.size(), &header, &result);
+        verifyConsistent(data, offset, result, header);
+        if (QTest::currentTestFailed()) {
+            qWarning() << "Failed in round" << round << "with" << data.toHex();
+            return;
+        }
+    }
+}
+
+void TestOtaImageHeader::fuzzMutatedHeaders()
+{
+    QRandomGenerator generator(0x0beef11e);
+    for (int round = 0; round < 5000; round++) {
+        QByteArray data = buildHeader(static_cast<quint16>(56 + generator.bounded(40)), 5000, static_cast<quint16>(generator.bounded(8)));
+        int mutations = 1 + generator.bounded(6);
+        for (int i = 0; i < mutations; i++) {
+            data[static_cast<int>(generator.bounded(data.size()))] = static_cast<char>(generator.bounded(256));
+        }
+        // Parse a heap copy of a random prefix, reading beyond it is an error a sanitizer build reports
+        int length = generator.bounded(data.size() + 1);
+        QByteArray prefix(data.constData(), length);
+
+        ZigbeeOtaImageHeader header;
+        ZigbeeOtaImageHeader::ParseResult result;
+        int offset = ZigbeeOtaImageHeader::find(prefix.constData(), prefix.size(), &header, &result);
+        verifyConsistent(prefix, offset, result, header);
+        if (QTest::currentTestFailed()) {
+            qWarning() << "Failed in round" << round << "with" << prefix.toHex();
+            return;
+        }
+    }
+}
+
+void TestOtaImageHeader::benchmarkParse()
+{
+    QByteArray data = buildHeader(69, 1000, 0x07);
+    ZigbeeOtaImageHeader header;
+    QBENCHMARK {
+        ZigbeeOtaImageHeader::parse(data.constData(), data.size(), &header);
+    }
+    QCOMPARE(header.totalImageSize, static_cast<quint32>(1000));
+}
+
+void TestOtaImageHeader::benchmarkFind()
+{
+    // Worst case for a download: the image sits behind a large vendor container
+    QByteArray data(1024 * 1024, '\0');
+    QRandomGenerator generator(42);
+    for (int i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(generator.bounded(256));
+    }
+    data.append(buildHeader(56, 1000));
+
+    int offset = -1;
+    QBENCHMARK {
+        ZigbeeOtaImageHeader header;
+        ZigbeeOtaImageHeader::ParseResult result;
+        offset = ZigbeeOtaImageHeader::find(data.constData(), data.size(), &header, &result);
+    }
+    QVERIFY(offset >= 0);
+}
+
+QTEST_GUILESS_MAIN(TestOtaImageHeader)
+#include "testotaimageheader.moc"
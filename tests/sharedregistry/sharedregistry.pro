@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = testsharedregistry
+
+SOURCES += \
+    testsharedregistry.cpp \
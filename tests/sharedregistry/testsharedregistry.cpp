@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeesharedregistry.h"
+
+#include <QtTest>
+#include <QPointer>
+
+class TestSharedRegistry: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void shareInstancePerKey();
+    void deleteAfterLastRelease();
+    void acquireAgainBeforeDeferredDelete();
+    void ignoreReleaseOfStaleInstance();
+    void removeDestroyedInstance();
+
+private:
+    static void processDeferredDeletes();
+};
+
+void TestSharedRegistry::processDeferredDeletes()
+{
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void TestSharedRegistry::shareInstancePerKey()
+{
+    ZigbeeSharedRegistry<QObject, QString> registry;
+    QObject first;
+    QObject second;
+    int created = 0;
+    auto create = [&created](){
+        created++;
+        return new QObject();
+    };
+
+    QObject *a = registry.acquire("a", &first, create);
+    QCOMPARE(registry.acquire("a", &second, create), a);
+    QObject *b = registry.acquire("b", &first, create);
+    QVERIFY(b != a);
+    QCOMPARE(created, 2);
+    QCOMPARE(registry.subscribers("a"), QSet<QObject*>({&first, &second}));
+    QCOMPARE(registry.subscribers("b"), QSet<QObject*>({&first}));
+
+    QVERIFY(registry.release("a", a, &first));
+    QVERIFY(registry.release("a", a, &second));
+    QVERIFY(registry.release("b", b, &first));
+    processDeferredDeletes();
+}
+
+void TestSharedRegistry::deleteAfterLastRelease()
+{
+    ZigbeeSharedRegistry<QObject> registry;
+    QObject first;
+    QObject second;
+
+    QPointer<QObject> instance = registry.acquire(&first, [](){ return new QObject(); });
+    registry.acquire(&second, [](){ return new QObject(); });
+
+    QVERIFY(!registry.release(instance, &first));
+    processDeferredDeletes();
+    QVERIFY(!instance.isNull());
+
+    QVERIFY(registry.release(instance, &second));
+    QVERIFY(registry.subscribers().isEmpty());
+    processDeferredDeletes();
+    QVERIFY(instance.isNull());
+}
+
+void TestSharedRegistry::acquireAgainBeforeDeferredDelete()
+{
+    ZigbeeSharedRegistry<QObject> registry;
+    QObject subscriber;
+
+    QPointer<QObject> released = registry.acquire(&subscriber, [](){ return new QObject(); });
+    QVERIFY(registry.release(released, &subscriber));
+
+    // The released instance is still alive, but must not be handed out again
+    QVERIFY(!released.isNull());
+    QPointer<QObject> acquired = registry.acquire(&subscriber, [](){ return new QObject(); });
+    QVERIFY(acquired != released);
+
+    processDeferredDeletes();
+    QVERIFY(released.isNull());
+    QVERIFY(!acquired.isNull());
+
+    QVERIFY(registry.release(acquired, &subscriber));
+    processDeferredDeletes();
+    QVERIFY(acquired.isNull());
+}
+
+void TestSharedRegistry::ignoreReleaseOfStaleInstance()
+{
+    ZigbeeSharedRegistry<QObject> registry;
+    QObject subscriber;
+
+    QObject *released = registry.acquire(&subscriber, [](){ return new QObject(); });
+    QVERIFY(registry.release(released, &subscriber));
+    QPointer<QObject> acquired = registry.acquire(&subscriber, [](){ return new QObject(); });
+
+    // Releasing the old instance again must neither unregister nor delete the new one
+    QVERIFY(!registry.release(released, &subscriber));
+    QCOMPARE(registry.subscribers(), QSet<QObject*>({&subscriber}));
+    processDeferredDeletes();
+    QVERIFY(!acquired.isNull());
+
+    QVERIFY(registry.release(acquired, &subscriber));
+    processDeferredDeletes();
+}
+
+void TestSharedRegistry::removeDestroyedInstance()
+{
+    ZigbeeSharedRegistry<QObject> registry;
+    QObject subscriber;
+
+    QObject *destroyed = registry.acquire(&subscriber, [](){ return new QObject(); });
+    registry.remove(destroyed);
+    delete destroyed;
+    QVERIFY(registry.subscribers().isEmpty());
+
+    QObject *acquired = registry.acquire(&subscriber, [](){ return new QObject(); });
+    QVERIFY(acquired);
+    // Removing anything but the registered instance has no effect
+    registry.remove(destroyed);
+    QCOMPARE(registry.subscribers(), QSet<QObject*>({&subscriber}));
+
+    QVERIFY(registry.release(acquired, &subscriber));
+    processDeferredDeletes();
+}
+
+QTEST_GUILESS_MAIN(TestSharedRegistry)
+#include "testsharedregistry.moc"
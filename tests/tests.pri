@@ -0,0 +1,9 @@
+# Unit tests run against the firmware library from the build tree, they are never installed
+QT += testlib network
+QT -= gui
+
+CONFIG += testcase no_testcase_installs c++11
+
+INCLUDEPATH += $$PWD/../firmware
+LIBS += -L$$OUT_PWD/../../firmware -lnymea-plugins-zigbee-firmware
+QMAKE_RPATHDIR += $$OUT_PWD/../../firmware
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    firmwareindexreader \
+    firmwareindexservice \
+    lumimodelmatcher \
+    otaimageheader \
+    sharedregistry \
+
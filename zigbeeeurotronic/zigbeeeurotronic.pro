@@ -4,11 +4,29 @@ PKGCONFIG += nymea-zigbee
 
 SOURCES += \
     ../common/zigbeeintegrationplugin.cpp \
-    integrationpluginzigbeeeurotronic.cpp
+    integrationpluginzigbeeeurotronic.cpp \
+    ../common/zigbeeotasession.cpp \
+    ../common/zigbeefirmwareverifier.cpp \
+    ../common/zigbeeotaimagewriter.cpp \
+    ../common/zigbeeotatelemetry.cpp \
+    ../common/zigbeeotaprogressreporter.cpp \
+    ../common/zigbeeotablockpacer.cpp \
+    ../common/zigbeenoderegistry.cpp \
+    ../common/zigbeethingclassids.cpp \
+    ../common/zigbeestatebinder.cpp
 
 HEADERS += \
     ../common/zigbeeintegrationplugin.h \
-    integrationpluginzigbeeeurotronic.h
+    integrationpluginzigbeeeurotronic.h \
+    ../common/zigbeeotasession.h \
+    ../common/zigbeefirmwareverifier.h \
+    ../common/zigbeeotaimagewriter.h \
+    ../common/zigbeeotatelemetry.h \
+    ../common/zigbeeotaprogressreporter.h \
+    ../common/zigbeeotablockpacer.h \
+    ../common/zigbeenoderegistry.h \
+    ../common/zigbeethingclassids.h \
+    ../common/zigbeestatebinder.h
 
 
 
@@ -57,185 +57,188 @@ bool IntegrationPluginZigbeeGeneric::handleNode(ZigbeeNode *node, const QUuid &/
     foreach (ZigbeeNodeEndpoint *endpoint, node->endpoints()) {
         qCDebug(dcZigbeeGeneric()) << "Checking node endpoint:" << endpoint->endpointId() << endpoint->deviceId();
 
-        // OnOff light
-        if ((endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileLightLink &&
-             endpoint->deviceId() == Zigbee::LightLinkDevice::LightLinkDeviceOnOffLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation &&
-                 endpoint->deviceId() == Zigbee::HomeAutomationDeviceOnOffLight)) {
-
-            qCDebug(dcZigbeeGeneric()) << "Handling on/off light for" << node << endpoint;
-            createThing(onOffLightThingClassId, node, {Param(onOffLightThingEndpointIdParamTypeId, endpoint->endpointId())});
-            configureOnOffInputClusterAttributeReporting(endpoint);
-            handled = true;
+        QHash<quint32, EndpointHandler>::const_iterator it = endpointHandlers().constFind(endpointKey(endpoint->profile(), endpoint->deviceId()));
+        if (it == endpointHandlers().constEnd()) {
+            continue;
         }
 
-        // Dimmable light
-        if ((endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileLightLink &&
-             endpoint->deviceId() == Zigbee::LightLinkDevice::LightLinkDeviceDimmableLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation &&
-                 endpoint->deviceId() == Zigbee::HomeAutomationDeviceDimmableLight)) {
-
-            qCDebug(dcZigbeeGeneric()) << "Handling dimmable light for" << node << endpoint;
-            createThing(dimmableLightThingClassId, node, {Param(dimmableLightThingEndpointIdParamTypeId, endpoint->endpointId())});
-            configureOnOffInputClusterAttributeReporting(endpoint);
-            bindLevelControlCluster(endpoint);
-            configureLevelControlInputClusterAttributeReporting(endpoint);
-            handled = true;
+        const EndpointHandler &handler = it.value();
+        bool complete = true;
+        foreach (ZigbeeClusterLibrary::ClusterId clusterId, handler.requiredInputClusters) {
+            complete &= endpoint->hasInputCluster(clusterId);
         }
-
-        // CT light
-        if ((endpoint->profile() == Zigbee::ZigbeeProfileLightLink &&
-             endpoint->deviceId() == Zigbee::LightLinkDeviceColourTemperatureLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfileHomeAutomation &&
-                 endpoint->deviceId() == Zigbee::HomeAutomationDeviceColourTemperatureLight)) {
-
-            qCDebug(dcZigbeeGeneric()) << "Handling color temperature light for" << node << endpoint;
-            createThing(colorTemperatureLightThingClassId, node, {Param(colorTemperatureLightThingEndpointIdParamTypeId, endpoint->endpointId())});
-            configureOnOffInputClusterAttributeReporting(endpoint);
-            bindLevelControlCluster(endpoint);
-            configureLevelControlInputClusterAttributeReporting(endpoint);
-            handled = true;
+        if (!complete) {
+            qCWarning(dcZigbeeGeneric()) << "Endpoint claims to be a" << handler.name << "but the appropriate input clusters could not be found" << node << endpoint;
+            continue;
         }
 
-        // Color light
-        if ((endpoint->profile() == Zigbee::ZigbeeProfileLightLink && endpoint->deviceId() == Zigbee::LightLinkDeviceColourLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfileLightLink && endpoint->deviceId() == Zigbee::LightLinkDeviceExtendedColourLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceExtendedColourLight) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceDimmableColorLight)) {
-
-            qCDebug(dcZigbeeGeneric()) << "Handling color light for" << node << endpoint;
-            createThing(colorLightThingClassId, node, {Param(colorLightThingEndpointIdParamTypeId, endpoint->endpointId())});
-            configureOnOffInputClusterAttributeReporting(endpoint);
-            bindLevelControlCluster(endpoint);
-            configureLevelControlInputClusterAttributeReporting(endpoint);
-            handled = true;
+        qCDebug(dcZigbeeGeneric()) << "Handling" << handler.name << "for" << node << endpoint;
+        if (!handler.thingClassId.isNull()) {
+            createThing(handler.thingClassId, node, {Param(handler.endpointIdParamTypeId, endpoint->endpointId())});
         }
+        (this->*handler.initializer)(node, endpoint);
+        handled = true;
+    }
 
-        // Check thermostat
-        if (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation &&
-                endpoint->deviceId() == Zigbee::HomeAutomationDeviceThermostat) {
-            qCDebug(dcZigbeeGeneric()) << "Handling thermostat endpoint for" << node << endpoint;
-            createThing(thermostatThingClassId, node, {Param(thermostatThingEndpointIdParamTypeId, endpoint->endpointId())});
-            bindPowerConfigurationCluster(endpoint);
-            configurePowerConfigurationInputClusterAttributeReporting(endpoint);
-            bindThermostatCluster(endpoint);
-            handled = true;
-        }
+    return handled;
+}
 
-        // Check on/off thing
-        if ((endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileLightLink && endpoint->deviceId() == Zigbee::LightLinkDevice::LightLinkDeviceOnOffPlugin) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceOnOffPlugin) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceMainPowerOutlet) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceSmartPlug) ||
-                (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceOnOffOutput)) {
+quint32 IntegrationPluginZigbeeGeneric::endpointKey(quint16 profile, quint16 deviceId)
+{
+    return static_cast<quint32>(profile) << 16 | deviceId;
+}
 
-            // Simple on/off device
-            if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdOnOff)) {
+const QHash<quint32, IntegrationPluginZigbeeGeneric::EndpointHandler> &IntegrationPluginZigbeeGeneric::endpointHandlers()
+{
+    // Endpoints are classified by profile and device id. Handlers without a thing class create
+    // their things in the initializer, depending on the clusters of the endpoint.
+    static const EndpointHandler onOffLight = {"on/off light", onOffLightThingClassId, onOffLightThingEndpointIdParamTypeId, {}, &IntegrationPluginZigbeeGeneric::initLight};
+    static const EndpointHandler dimmableLight = {"dimmable light", dimmableLightThingClassId, dimmableLightThingEndpointIdParamTypeId, {}, &IntegrationPluginZigbeeGeneric::initDimmableLight};
+    static const EndpointHandler colorTemperatureLight = {"color temperature light", colorTemperatureLightThingClassId, colorTemperatureLightThingEndpointIdParamTypeId, {}, &IntegrationPluginZigbeeGeneric::initDimmableLight};
+    static const EndpointHandler colorLight = {"color light", colorLightThingClassId, colorLightThingEndpointIdParamTypeId, {}, &IntegrationPluginZigbeeGeneric::initDimmableLight};
+    static const EndpointHandler thermostat = {"thermostat", thermostatThingClassId, thermostatThingEndpointIdParamTypeId, {}, &IntegrationPluginZigbeeGeneric::initThermostat};
+    static const EndpointHandler powerSocket = {"power socket", ThingClassId(), ParamTypeId(), {ZigbeeClusterLibrary::ClusterIdOnOff}, &IntegrationPluginZigbeeGeneric::initPowerSocket};
+    static const EndpointHandler doorLock = {"door lock", doorLockThingClassId, doorLockThingEndpointIdParamTypeId, {ZigbeeClusterLibrary::ClusterIdPowerConfiguration, ZigbeeClusterLibrary::ClusterIdDoorLock}, &IntegrationPluginZigbeeGeneric::initDoorLock};
+    static const EndpointHandler iasZone = {"IAS zone device", ThingClassId(), ParamTypeId(), {ZigbeeClusterLibrary::ClusterIdIasZone}, &IntegrationPluginZigbeeGeneric::initIasZone};
+    static const EndpointHandler temperatureSensor = {"temperature sensor", ThingClassId(), ParamTypeId(), {}, &IntegrationPluginZigbeeGeneric::initTemperatureSensor};
+
+    static const QHash<quint32, EndpointHandler> handlers = {
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceOnOffLight), onOffLight},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceOnOffLight), onOffLight},
+
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceDimmableLight), dimmableLight},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceDimmableLight), dimmableLight},
+
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceColourTemperatureLight), colorTemperatureLight},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceColourTemperatureLight), colorTemperatureLight},
+
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceColourLight), colorLight},
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceExtendedColourLight), colorLight},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceExtendedColourLight), colorLight},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceDimmableColorLight), colorLight},
+
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceThermostat), thermostat},
+
+        {endpointKey(Zigbee::ZigbeeProfileLightLink, Zigbee::LightLinkDeviceOnOffPlugin), powerSocket},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceOnOffPlugin), powerSocket},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceMainPowerOutlet), powerSocket},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceSmartPlug), powerSocket},
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceOnOffOutput), powerSocket},
+
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceDoorLock), doorLock},
+
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceIasZone), iasZone},
+
+        {endpointKey(Zigbee::ZigbeeProfileHomeAutomation, Zigbee::HomeAutomationDeviceTemperatureSensor), temperatureSensor}
+    };
+    return handlers;
+}
 
-                if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdMetering)) {
-                    qCDebug(dcZigbeeGeneric()) << "Handling power socket with energy metering for" << node << endpoint;
-                    createThing(powerMeterSocketThingClassId, node, {Param(powerMeterSocketThingEndpointIdParamTypeId, endpoint->endpointId())});
-                    bindMeteringCluster(endpoint);
-                    configureMeteringInputClusterAttributeReporting(endpoint);
+void IntegrationPluginZigbeeGeneric::initLight(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    Q_UNUSED(node)
+    configureOnOffInputClusterAttributeReporting(endpoint);
+}
 
-                } else {
-                    qCDebug(dcZigbeeGeneric()) << "Handling power socket endpoint for" << node << endpoint;
-                    createThing(powerSocketThingClassId, node, {Param(powerSocketThingEndpointIdParamTypeId, endpoint->endpointId())});
-                }
+void IntegrationPluginZigbeeGeneric::initDimmableLight(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    Q_UNUSED(node)
+    configureOnOffInputClusterAttributeReporting(endpoint);
+    bindLevelControlCluster(endpoint);
+    configureLevelControlInputClusterAttributeReporting(endpoint);
+}
 
-                bindOnOffCluster(endpoint);
-                configureOnOffInputClusterAttributeReporting(endpoint);
-                handled = true;
-            }
-        }
+void IntegrationPluginZigbeeGeneric::initThermostat(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    Q_UNUSED(node)
+    bindPowerConfigurationCluster(endpoint);
+    configurePowerConfigurationInputClusterAttributeReporting(endpoint);
+    bindThermostatCluster(endpoint);
+}
 
-        // Check door lock
-        if (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceDoorLock) {
-            if (!endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdPowerConfiguration) ||
-                    !endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdDoorLock)) {
-                qCWarning(dcZigbeeGeneric()) << "Endpoint claims to be a door lock, but the appropriate input clusters could not be found" << node << endpoint;
-            } else {
-                qCDebug(dcZigbeeGeneric()) << "Handling door lock endpoint for" << node << endpoint;
-                createThing(doorLockThingClassId, node, {Param(doorLockThingEndpointIdParamTypeId, endpoint->endpointId())});
-                // Initialize bindings and cluster attributes
-                initDoorLock(node, endpoint);
-                handled = true;
-            }
-        }
+void IntegrationPluginZigbeeGeneric::initPowerSocket(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdMetering)) {
+        qCDebug(dcZigbeeGeneric()) << "Handling power socket with energy metering for" << node << endpoint;
+        createThing(powerMeterSocketThingClassId, node, {Param(powerMeterSocketThingEndpointIdParamTypeId, endpoint->endpointId())});
+        bindMeteringCluster(endpoint);
+        configureMeteringInputClusterAttributeReporting(endpoint);
 
-        // Security sensors
-        if (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceIasZone) {
-            qCInfo(dcZigbeeGeneric()) << "IAS Zone device found!";
+    } else {
+        qCDebug(dcZigbeeGeneric()) << "Handling power socket endpoint for" << node << endpoint;
+        createThing(powerSocketThingClassId, node, {Param(powerSocketThingEndpointIdParamTypeId, endpoint->endpointId())});
+    }
 
-            bindPowerConfigurationCluster(endpoint);
-            configurePowerConfigurationInputClusterAttributeReporting(endpoint);
+    bindOnOffCluster(endpoint);
+    configureOnOffInputClusterAttributeReporting(endpoint);
+}
 
-            // We need to read the Type cluster to determine what this actually is...
-            ZigbeeClusterIasZone *iasZoneCluster = endpoint->inputCluster<ZigbeeClusterIasZone>(ZigbeeClusterLibrary::ClusterIdIasZone);
-            ZigbeeClusterReply *reply = iasZoneCluster->readAttributes({ZigbeeClusterIasZone::AttributeZoneType});
-            connect(reply, &ZigbeeClusterReply::finished, this, [=](){
-                if (reply->error() != ZigbeeClusterReply::ErrorNoError) {
-                    qCWarning(dcZigbeeGeneric()) << "Reading IAS Zone type attribute finished with error" << reply->error();
-                    return;
-                }
+void IntegrationPluginZigbeeGeneric::initIasZone(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    qCInfo(dcZigbeeGeneric()) << "IAS Zone device found!";
 
-                QList<ZigbeeClusterLibrary::ReadAttributeStatusRecord> attributeStatusRecords = ZigbeeClusterLibrary::parseAttributeStatusRecords(reply->responseFrame().payload);
-                if (attributeStatusRecords.count() != 1 || attributeStatusRecords.first().attributeId != ZigbeeClusterIasZone::AttributeZoneType) {
-                    qCWarning(dcZigbeeGeneric()) << "Unexpected reply in reading IAS Zone device type:" << attributeStatusRecords;
-                    return;
-                }
+    bindPowerConfigurationCluster(endpoint);
+    configurePowerConfigurationInputClusterAttributeReporting(endpoint);
 
-                bindIasZoneCluster(endpoint);
-
-                ZigbeeClusterLibrary::ReadAttributeStatusRecord iasZoneTypeRecord = attributeStatusRecords.first();
-                qCDebug(dcZigbeeGeneric()) << "IAS Zone device type:" << iasZoneTypeRecord.dataType.toUInt16();
-                switch (iasZoneTypeRecord.dataType.toUInt16()) {
-                case ZigbeeClusterIasZone::ZoneTypeContactSwitch:
-                    qCInfo(dcZigbeeGeneric()) << "Creating contact switch thing";
-                    createThing(doorSensorThingClassId, node, {Param(doorSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-                    break;
-                case ZigbeeClusterIasZone::ZoneTypeMotionSensor:
-                    qCInfo(dcZigbeeGeneric()) << "Creating motion sensor thing";
-                    createThing(motionSensorThingClassId, node, {Param(motionSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-                    break;
-                case ZigbeeClusterIasZone::ZoneTypeFireSensor:
-                    qCInfo(dcZigbeeGeneric()) << "Fire sensor thing";
-                    createThing(fireSensorThingClassId, node, {Param(fireSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-                    break;
-                case ZigbeeClusterIasZone::ZoneTypeWaterSensor:
-                    qCInfo(dcZigbeeGeneric()) << "Water sensor thing";
-                    createThing(waterSensorThingClassId, node, {Param(waterSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-                    break;
-                default:
-                    qCWarning(dcZigbeeGeneric()) << "Unhandled IAS Zone device type:" << "0x" + QString::number(iasZoneTypeRecord.dataType.toUInt16(), 16);
+    // We need to read the Type cluster to determine what this actually is...
+    ZigbeeClusterIasZone *iasZoneCluster = endpoint->inputCluster<ZigbeeClusterIasZone>(ZigbeeClusterLibrary::ClusterIdIasZone);
+    ZigbeeClusterReply *reply = iasZoneCluster->readAttributes({ZigbeeClusterIasZone::AttributeZoneType});
+    connect(reply, &ZigbeeClusterReply::finished, this, [=](){
+        if (reply->error() != ZigbeeClusterReply::ErrorNoError) {
+            qCWarning(dcZigbeeGeneric()) << "Reading IAS Zone type attribute finished with error" << reply->error();
+            return;
+        }
 
-                }
+        QList<ZigbeeClusterLibrary::ReadAttributeStatusRecord> attributeStatusRecords = ZigbeeClusterLibrary::parseAttributeStatusRecords(reply->responseFrame().payload);
+        if (attributeStatusRecords.count() != 1 || attributeStatusRecords.first().attributeId != ZigbeeClusterIasZone::AttributeZoneType) {
+            qCWarning(dcZigbeeGeneric()) << "Unexpected reply in reading IAS Zone device type:" << attributeStatusRecords;
+            return;
+        }
 
-            });
+        bindIasZoneCluster(endpoint);
+
+        ZigbeeClusterLibrary::ReadAttributeStatusRecord iasZoneTypeRecord = attributeStatusRecords.first();
+        qCDebug(dcZigbeeGeneric()) << "IAS Zone device type:" << iasZoneTypeRecord.dataType.toUInt16();
+        switch (iasZoneTypeRecord.dataType.toUInt16()) {
+        case ZigbeeClusterIasZone::ZoneTypeContactSwitch:
+            qCInfo(dcZigbeeGeneric()) << "Creating contact switch thing";
+            createThing(doorSensorThingClassId, node, {Param(doorSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
+            break;
+        case ZigbeeClusterIasZone::ZoneTypeMotionSensor:
+            qCInfo(dcZigbeeGeneric()) << "Creating motion sensor thing";
+            createThing(motionSensorThingClassId, node, {Param(motionSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
+            break;
+        case ZigbeeClusterIasZone::ZoneTypeFireSensor:
+            qCInfo(dcZigbeeGeneric()) << "Fire sensor thing";
+            createThing(fireSensorThingClassId, node, {Param(fireSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
+            break;
+        case ZigbeeClusterIasZone::ZoneTypeWaterSensor:
+            qCInfo(dcZigbeeGeneric()) << "Water sensor thing";
+            createThing(waterSensorThingClassId, node, {Param(waterSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
+            break;
+        default:
+            qCWarning(dcZigbeeGeneric()) << "Unhandled IAS Zone device type:" << "0x" + QString::number(iasZoneTypeRecord.dataType.toUInt16(), 16);
 
-            handled = true;
         }
 
-        if (endpoint->profile() == Zigbee::ZigbeeProfile::ZigbeeProfileHomeAutomation && endpoint->deviceId() == Zigbee::HomeAutomationDeviceTemperatureSensor) {
-            bindPowerConfigurationCluster(endpoint);
-            configurePowerConfigurationInputClusterAttributeReporting(endpoint);
-            bindTemperatureMeasurementCluster(endpoint);
-            configureTemperatureMeasurementInputClusterAttributeReporting(endpoint);
+    });
+}
 
-            if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdRelativeHumidityMeasurement)) {
-                qCInfo(dcZigbeeGeneric()) << "H/T sensor device found!";
-                createThing(htSensorThingClassId, node, {Param(htSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-                bindRelativeHumidityMeasurementCluster(endpoint);
-            } else {
-                qCInfo(dcZigbeeGeneric()) << "Temperature sensor device found!";
-                createThing(temperatureSensorThingClassId, node, {Param(temperatureSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
-            }
+void IntegrationPluginZigbeeGeneric::initTemperatureSensor(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
+{
+    bindPowerConfigurationCluster(endpoint);
+    configurePowerConfigurationInputClusterAttributeReporting(endpoint);
+    bindTemperatureMeasurementCluster(endpoint);
+    configureTemperatureMeasurementInputClusterAttributeReporting(endpoint);
 
-            handled = true;
-        }
+    if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdRelativeHumidityMeasurement)) {
+        qCInfo(dcZigbeeGeneric()) << "H/T sensor device found!";
+        createThing(htSensorThingClassId, node, {Param(htSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
+        bindRelativeHumidityMeasurementCluster(endpoint);
+    } else {
+        qCInfo(dcZigbeeGeneric()) << "Temperature sensor device found!";
+        createThing(temperatureSensorThingClassId, node, {Param(temperatureSensorThingEndpointIdParamTypeId, endpoint->endpointId())});
     }
-
-    return handled;
 }
 
 void IntegrationPluginZigbeeGeneric::setupThing(ThingSetupInfo *info)
@@ -560,14 +563,12 @@ void IntegrationPluginZigbeeGeneric::executeAction(ThingActionInfo *info)
 
 ZigbeeNodeEndpoint *IntegrationPluginZigbeeGeneric::findEndpoint(Thing *thing)
 {
-    ZigbeeNode *node = nodeForThing(thing);
-    if (!node) {
+    if (!nodeForThing(thing)) {
         qCWarning(dcZigbeeGeneric()) << "Could not find the node for" << thing;
         return nullptr;
     }
 
-    quint8 endpointId = thing->paramValue("endpointId").toUInt();
-    return node->getEndpoint(endpointId);
+    return endpointForThing(thing);
 }
 
 void IntegrationPluginZigbeeGeneric::initSimplePowerSocket(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint)
@@ -56,8 +56,30 @@ public:
     void executeAction(ThingActionInfo *info) override;
 
 private:
+    typedef void (IntegrationPluginZigbeeGeneric::*EndpointInitializer)(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+
+    // Describes how an endpoint of a given profile and device id is handled
+    struct EndpointHandler {
+        const char *name;
+        // The thing to create, null if the initializer decides that
+        ThingClassId thingClassId;
+        ParamTypeId endpointIdParamTypeId;
+        QList<ZigbeeClusterLibrary::ClusterId> requiredInputClusters;
+        // Binds clusters and configures attribute reporting
+        EndpointInitializer initializer;
+    };
+
+    static quint32 endpointKey(quint16 profile, quint16 deviceId);
+    static const QHash<quint32, EndpointHandler> &endpointHandlers();
+
     ZigbeeNodeEndpoint *findEndpoint(Thing *thing);
 
+    void initLight(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+    void initDimmableLight(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+    void initThermostat(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+    void initPowerSocket(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+    void initIasZone(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
+    void initTemperatureSensor(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
     void initSimplePowerSocket(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
     void initDoorLock(ZigbeeNode *node, ZigbeeNodeEndpoint *endpoint);
 };
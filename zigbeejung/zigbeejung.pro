@@ -5,10 +5,28 @@ PKGCONFIG += nymea-zigbee
 SOURCES += \
     integrationpluginzigbeejung.cpp \
     ../common/zigbeeintegrationplugin.cpp \
+    ../common/zigbeeotasession.cpp \
+    ../common/zigbeefirmwareverifier.cpp \
+    ../common/zigbeeotaimagewriter.cpp \
+    ../common/zigbeeotatelemetry.cpp \
+    ../common/zigbeeotaprogressreporter.cpp \
+    ../common/zigbeeotablockpacer.cpp \
+    ../common/zigbeenoderegistry.cpp \
+    ../common/zigbeethingclassids.cpp \
+    ../common/zigbeestatebinder.cpp \
 
 HEADERS += \
     integrationpluginzigbeejung.h \
     ../common/zigbeeintegrationplugin.h \
+    ../common/zigbeeotasession.h \
+    ../common/zigbeefirmwareverifier.h \
+    ../common/zigbeeotaimagewriter.h \
+    ../common/zigbeeotatelemetry.h \
+    ../common/zigbeeotaprogressreporter.h \
+    ../common/zigbeeotablockpacer.h \
+    ../common/zigbeenoderegistry.h \
+    ../common/zigbeethingclassids.h \
+    ../common/zigbeestatebinder.h \
 
 
 
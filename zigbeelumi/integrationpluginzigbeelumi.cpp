@@ -52,18 +52,6 @@ IntegrationPluginZigbeeLumi::IntegrationPluginZigbeeLumi():
     ZigbeeIntegrationPlugin(ZigbeeHardwareResource::HandlerTypeVendor, dcZigbeeLumi())
 {
 
-    // Known model identifier
-    m_knownLumiDevices.insert("lumi.sensor_ht", lumiHTSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.sensor_magnet", lumiMagnetSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.sensor_switch", lumiButtonSensorThingClassId);
-    // Check sensor_motion separate since the have the same name but different features
-    //m_knownLumiDevices.insert("lumi.sensor_motion", lumiMotionSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.sensor_wleak", lumiWaterSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.weather", lumiWeatherSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.vibration", lumiVibrationSensorThingClassId);
-    m_knownLumiDevices.insert("lumi.plug", lumiPowerSocketThingClassId);
-    m_knownLumiDevices.insert("lumi.relay", lumiRelayThingClassId);
-    m_knownLumiDevices.insert("lumi.remote", lumiRemoteThingClassId);
 }
 
 QString IntegrationPluginZigbeeLumi::name() const
@@ -83,30 +71,11 @@ bool IntegrationPluginZigbeeLumi::handleNode(ZigbeeNode *node, const QUuid &/*ne
             continue;
         }
 
-        ThingClassId thingClassId;
-        if (endpoint->modelIdentifier().startsWith("lumi.sensor_motion")) {
-            // Check if this is a xiaomi or aquara motion sensor
-            if (endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdIlluminanceMeasurement)) {
-                thingClassId = lumiMotionSensorThingClassId;
-            } else {
-                thingClassId = xiaomiMotionSensorThingClassId;
-            }
-
-        } else if (endpoint->modelIdentifier() == "lumi.remote.b1acn01") {
-            thingClassId = lumiLongpressButtonSensorThingClassId;
-
-        } else if (endpoint->modelIdentifier() == "lumi.plug.maeu01" || endpoint->modelIdentifier() == "lumi.plug.mmeu01") {
-            thingClassId = lumiPowerSocketThingClassId;
+        ZigbeeLumiModelMatcher::Model model = m_modelMatcher.match(endpoint->modelIdentifier(), endpoint->hasInputCluster(ZigbeeClusterLibrary::ClusterIdIlluminanceMeasurement));
+        ThingClassId thingClassId = thingClassIdForModel(model);
+        if (endpoint->modelIdentifier() == "lumi.plug.maeu01" || endpoint->modelIdentifier() == "lumi.plug.mmeu01") {
             bindElectricalMeasurementCluster(endpoint);
             bindMeteringCluster(endpoint);
-
-        } else {
-            foreach (const QString &knownLumi, m_knownLumiDevices.keys()) {
-                if (endpoint->modelIdentifier().startsWith(knownLumi)) {
-                    thingClassId = m_knownLumiDevices.value(knownLumi);
-                    break;
-                }
-            }
         }
         if (thingClassId.isNull()) {
             qCWarning(dcZigbeeLumi()) << "Unhandled Lumi device:" << endpoint->modelIdentifier();
@@ -120,6 +89,39 @@ bool IntegrationPluginZigbeeLumi::handleNode(ZigbeeNode *node, const QUuid &/*ne
     return false;
 }
 
+ThingClassId IntegrationPluginZigbeeLumi::thingClassIdForModel(ZigbeeLumiModelMatcher::Model model)
+{
+    switch (model) {
+    case ZigbeeLumiModelMatcher::ModelUnknown:
+        break;
+    case ZigbeeLumiModelMatcher::ModelHTSensor:
+        return lumiHTSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelMagnetSensor:
+        return lumiMagnetSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelButtonSensor:
+        return lumiButtonSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelLongpressButtonSensor:
+        return lumiLongpressButtonSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelAqaraMotionSensor:
+        return lumiMotionSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelXiaomiMotionSensor:
+        return xiaomiMotionSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelWaterSensor:
+        return lumiWaterSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelWeatherSensor:
+        return lumiWeatherSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelVibrationSensor:
+        return lumiVibrationSensorThingClassId;
+    case ZigbeeLumiModelMatcher::ModelPowerSocket:
+        return lumiPowerSocketThingClassId;
+    case ZigbeeLumiModelMatcher::ModelRelay:
+        return lumiRelayThingClassId;
+    case ZigbeeLumiModelMatcher::ModelRemote:
+        return lumiRemoteThingClassId;
+    }
+    return ThingClassId();
+}
+
 void IntegrationPluginZigbeeLumi::setupThing(ThingSetupInfo *info)
 {
     Thing *thing = info->thing();
@@ -32,6 +32,7 @@
 #define INTEGRATIONPLUGINZIGBEELUMI_H
 
 #include "../common/zigbeeintegrationplugin.h"
+#include "zigbeelumimodelmatcher.h"
 #include "integrations/integrationplugin.h"
 #include "hardware/zigbee/zigbeehandler.h"
 #include "plugintimer.h"
@@ -57,7 +58,9 @@ public:
     void executeAction(ThingActionInfo *info) override;
 
 private:
-    QHash<QString, ThingClassId> m_knownLumiDevices;
+    ZigbeeLumiModelMatcher m_modelMatcher;
+
+    static ThingClassId thingClassIdForModel(ZigbeeLumiModelMatcher::Model model);
 
     PluginTimer *m_presenceTimer = nullptr;
 };
@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "zigbeelumimodelmatcher.h"
+
+ZigbeeLumiModelMatcher::ZigbeeLumiModelMatcher()
+{
+    // The root node
+    m_nodes.append(Node());
+
+    addModel("lumi.sensor_ht", ModelHTSensor);
+    addModel("lumi.sensor_magnet", ModelMagnetSensor);
+    addModel("lumi.sensor_switch", ModelButtonSensor);
+    addModel("lumi.sensor_motion", ModelAqaraMotionSensor);
+    addModel("lumi.sensor_wleak", ModelWaterSensor);
+    addModel("lumi.weather", ModelWeatherSensor);
+    addModel("lumi.vibration", ModelVibrationSensor);
+    addModel("lumi.plug", ModelPowerSocket);
+    addModel("lumi.relay", ModelRelay);
+    addModel("lumi.remote", ModelRemote);
+    addModel("lumi.remote.b1acn01", ModelLongpressButtonSensor);
+}
+
+ZigbeeLumiModelMatcher::Model ZigbeeLumiModelMatcher::match(const QString &modelIdentifier, bool hasIlluminanceMeasurement) const
+{
+    Model model = m_nodes.at(0).model;
+    int node = 0;
+    foreach (const QChar &character, modelIdentifier) {
+        QHash<QChar, int>::const_iterator it = m_nodes.at(node).children.constFind(character);
+        if (it == m_nodes.at(node).children.constEnd()) {
+            break;
+        }
+        node = it.value();
+        if (m_nodes.at(node).model != ModelUnknown) {
+            model = m_nodes.at(node).model;
+        }
+    }
+
+    if (model == ModelAqaraMotionSensor && !hasIlluminanceMeasurement) {
+        model = ModelXiaomiMotionSensor;
+    }
+    return model;
+}
+
+void ZigbeeLumiModelMatcher::addModel(const QString &prefix, Model model)
+{
+    int node = 0;
+    foreach (const QChar &character, prefix) {
+        int child = m_nodes.at(node).children.value(character, -1);
+        if (child < 0) {
+            child = m_nodes.count();
+            // Note: Don't hold a reference into m_nodes across the append
+            m_nodes.append(Node());
+            m_nodes[node].children.insert(character, child);
+        }
+        node = child;
+    }
+    m_nodes[node].model = model;
+}
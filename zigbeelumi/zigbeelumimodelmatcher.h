@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2022, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU Lesser General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation; version 3. This project is distributed in the hope that
+* it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef ZIGBEELUMIMODELMATCHER_H
+#define ZIGBEELUMIMODELMATCHER_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Maps Lumi model identifiers to the supported models. Identifiers are matched by their longest
+// known prefix, so specific models can be registered next to their family. The prefixes are kept
+// in a character trie, a lookup never walks further than the model identifier is long.
+class ZigbeeLumiModelMatcher
+{
+public:
+    enum Model {
+        ModelUnknown,
+        ModelHTSensor,
+        ModelMagnetSensor,
+        ModelButtonSensor,
+        ModelLongpressButtonSensor,
+        ModelAqaraMotionSensor,
+        ModelXiaomiMotionSensor,
+        ModelWaterSensor,
+        ModelWeatherSensor,
+        ModelVibrationSensor,
+        ModelPowerSocket,
+        ModelRelay,
+        ModelRemote
+    };
+
+    ZigbeeLumiModelMatcher();
+
+    // Xiaomi and Aqara motion sensors share the model identifier prefix, only the
+    // Aqara sensor has an illuminance measurement cluster.
+    Model match(const QString &modelIdentifier, bool hasIlluminanceMeasurement) const;
+
+private:
+    struct Node {
+        QHash<QChar, int> children;
+        Model model = ModelUnknown;
+    };
+
+    void addModel(const QString &prefix, Model model);
+
+    QVector<Node> m_nodes;
+};
+
+#endif // ZIGBEELUMIMODELMATCHER_H
@@ -31,6 +31,7 @@
 
 #include "integrationpluginzigbeetradfri.h"
 #include "plugininfo.h"
+#include "zigbeefirmwareindexreader.h"
 
 #include <zigbeeutils.h>
 #include <hardware/zigbee/zigbeehardwareresource.h>
@@ -40,7 +41,6 @@
 
 #include <qmath.h>
 #include <QMetaMethod>
-#include <QJsonDocument>
 
 
 #define AIR_PURIFIER_CLUSTER_ID 0xfc7d // Input cluster on endopint 1
@@ -657,25 +657,27 @@ void IntegrationPluginZigbeeTradfri::thingRemoved(Thing *thing)
 
 QList<ZigbeeIntegrationPlugin::FirmwareIndexEntry> IntegrationPluginZigbeeTradfri::firmwareIndexFromJson(const QByteArray &data) const
 {
-    qCDebug(dcZigbeeTradfri()) << "Fetched firmware index:" << qUtf8Printable(data);
-    QList<FirmwareIndexEntry> ret;
-
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &error);
-    if (error.error != QJsonParseError::NoError) {
-        qCWarning(dcZigbeeTradfri()) << "Failed to parse firmware index" << error.errorString() << "\n" << qUtf8Printable(data);
+    ZigbeeFirmwareIndexReader reader(data);
+    QList<FirmwareIndexEntry> ret = reader.read([](FirmwareIndexEntry *entry, const QLatin1String &key, const ZigbeeFirmwareIndexReader::Value &value){
+        if (key == QLatin1String("fw_file_version_MSB")) {
+            entry->fileVersion = (value.toUInt() << 16) | (entry->fileVersion & 0xffff);
+        } else if (key == QLatin1String("fw_file_version_LSB")) {
+            entry->fileVersion = (entry->fileVersion & 0xffff0000) | value.toUInt();
+        } else if (key == QLatin1String("fw_filesize")) {
+            entry->fileSize = value.toUInt();
+        } else if (key == QLatin1String("fw_image_type")) {
+            entry->imageType = value.toUInt();
+        } else if (key == QLatin1String("fw_manufacturer_id")) {
+            entry->manufacturerCode = value.toUInt();
+        } else if (key == QLatin1String("fw_binary_url")) {
+            entry->url = QUrl(value.toString());
+        }
+    });
+    if (reader.hasError()) {
+        qCWarning(dcZigbeeTradfri()) << "Failed to parse firmware index" << reader.errorString();
         return ret;
     }
-    foreach (const QVariant &entryVariant, jsonDoc.toVariant().toList()) {
-        QVariantMap map = entryVariant.toMap();
-        FirmwareIndexEntry entry;
-        entry.fileVersion = (map.value("fw_file_version_MSB").toUInt() << 16) | map.value("fw_file_version_LSB").toUInt();
-        entry.fileSize = map.value("fw_filesize").toUInt();
-        entry.imageType = map.value("fw_image_type").toUInt();
-        entry.manufacturerCode = map.value("fw_manufacturer_id").toUInt();
-        entry.url = map.value("fw_binary_url").toUrl();
-        ret.append(entry);
-    }
+    qCDebug(dcZigbeeTradfri()) << "Fetched firmware index with" << ret.count() << "entries";
 
     return ret;
 }